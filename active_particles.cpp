@@ -0,0 +1,268 @@
+#include "active_particles.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <functional>
+#include <iterator>
+
+namespace {
+bool canMove(const Cell cell)
+{
+    return (cell == Cell::Snow) || (cell == Cell::Sand);
+}
+
+bool canFallInto(const Cell cell)
+{
+    return (cell == Cell::Air) || (cell == Cell::Eraser);
+}
+
+// Branch-free versions for classifying whole rows, the arguments are 0 or 1.
+std::uint8_t isFallable(const Cell cell)
+{
+    return (cell == Cell::Air) | (cell == Cell::Eraser);
+}
+
+std::uint8_t isMovable(const Cell cell, const std::uint8_t below, const std::uint8_t belowRight, const std::uint8_t belowLeft)
+{
+    return ((cell == Cell::Snow) & below) | ((cell == Cell::Sand) & (below | belowRight | belowLeft));
+}
+
+Cell fall(const Cell top, const Cell bottom)
+{
+    return (bottom == Cell::Eraser) ? Cell::Eraser : top;
+}
+
+// Returns the cell `index` would fall into, or numberOfCells if it can't move.
+size_t findTarget(const Cell* const cells, const size_t index, const ptrdiff_t width, const size_t numberOfCells)
+{
+    const Cell cell = cells[index];
+    const size_t belowIndex = index + width;
+    if (!canMove(cell) || (belowIndex >= numberOfCells)) {
+        return numberOfCells;
+    }
+    if (canFallInto(cells[belowIndex])) {
+        return belowIndex;
+    }
+    if (cell == Cell::Sand) {
+        const ptrdiff_t x = index % width;
+        if ((x < (width - 1)) && canFallInto(cells[belowIndex + 1])) {
+            return belowIndex + 1;
+        }
+        if ((x > 0) && canFallInto(cells[belowIndex - 1])) {
+            return belowIndex - 1;
+        }
+    }
+    return numberOfCells;
+}
+
+// Appends to a list that is sorted from the highest index to the lowest one. The indices are generated in almost that
+// order while stepping (at most a few positions apart), so this is constant time in practice.
+void insertSorted(std::vector<std::uint32_t>& sorted, const std::uint32_t index)
+{
+    sorted.push_back(index);
+    for (size_t i = (sorted.size() - 1); (i > 0) && (sorted[i - 1] < index); --i) {
+        std::swap(sorted[i - 1], sorted[i]);
+    }
+}
+}
+
+ActiveParticleSimulation::ActiveParticleSimulation(const World& world)
+    : width(world.Width)
+    , height((world.Width == 0) ? 0 : static_cast<ptrdiff_t>(world.Cells.size()) / world.Width)
+    , queuedForStep(world.Cells.size(), 0)
+    , everyCellResult(Point(0, 0), Cell::Air)
+{
+    activateMovableCells(world);
+}
+
+size_t ActiveParticleSimulation::getActiveCells() const
+{
+    return active.size() + activatedFromOutside.size();
+}
+
+CellsChanged ActiveParticleSimulation::step(World& world, ActivityMap* activity)
+{
+    assert(static_cast<ptrdiff_t>(world.Width) == width);
+    assert(world.Cells.size() == queuedForStep.size());
+
+    const std::uint32_t thisStep = nextStep++;
+    std::sort(activatedFromOutside.begin(), activatedFromOutside.end(), std::greater<std::uint32_t>());
+    processing.clear();
+    std::merge(active.begin(), active.end(), activatedFromOutside.begin(), activatedFromOutside.end(), std::back_inserter(processing), std::greater<std::uint32_t>());
+    active.clear();
+    activatedFromOutside.clear();
+    wokenUp.clear();
+
+    const size_t numberOfCells = world.Cells.size();
+    if ((processing.size() * MaximumActiveShare) > numberOfCells) {
+        return stepEveryCell(world, activity);
+    }
+
+    Cell* const cells = world.Cells.data();
+    CellsChanged cellsChanged = 0;
+    // The candidates and the cells that were woken up in this step are both sorted, so they are merged on the fly to
+    // process the cells from the last one to the first one, just like in simulateStep.
+    size_t nextCandidate = 0;
+    size_t nextWokenUp = 0;
+    for (;;) {
+        const bool hasCandidate = (nextCandidate < processing.size());
+        const bool hasWokenUp = (nextWokenUp < wokenUp.size());
+        size_t cellIndex;
+        if (hasCandidate && (!hasWokenUp || (processing[nextCandidate] > wokenUp[nextWokenUp]))) {
+            cellIndex = processing[nextCandidate++];
+        } else if (hasWokenUp) {
+            cellIndex = wokenUp[nextWokenUp++];
+        } else {
+            break;
+        }
+
+        const size_t target = findTarget(cells, cellIndex, width, numberOfCells);
+        if (target == numberOfCells) {
+            continue;
+        }
+
+        const ptrdiff_t x = cellIndex % width;
+        cells[target] = fall(cells[cellIndex], cells[target]);
+        cells[cellIndex] = Cell::Air;
+        ++cellsChanged;
+        if (activity) {
+            const ptrdiff_t y = cellIndex / width;
+            ++activity->changes[(y / ActivityTileSize) * activity->tiles.x + (x / ActivityTileSize)];
+        }
+        if ((cells[target] != Cell::Eraser) && (queuedForStep[target] != nextStep)) {
+            queuedForStep[target] = nextStep;
+            insertSorted(active, static_cast<std::uint32_t>(target));
+        }
+
+        // the cells above may fall into the hole in this step, they have lower indices and are still to come
+        if (cellIndex >= static_cast<size_t>(width)) {
+            const size_t aboveIndex = cellIndex - width;
+            const auto wakeUp = [&](const size_t index) {
+                if (queuedForStep[index] != thisStep) {
+                    queuedForStep[index] = thisStep;
+                    insertSorted(wokenUp, static_cast<std::uint32_t>(index));
+                }
+            };
+            wakeUp(aboveIndex);
+            if (x > 0) {
+                wakeUp(aboveIndex - 1);
+            }
+            if (x < (width - 1)) {
+                wakeUp(aboveIndex + 1);
+            }
+        }
+    }
+    return cellsChanged;
+}
+
+CellsChanged ActiveParticleSimulation::stepEveryCell(World& world, ActivityMap* activity)
+{
+    everyCellResult.Width = world.Width;
+    everyCellResult.Cells.assign(world.Cells.size(), Cell::Air);
+    const CellsChanged cellsChanged = simulateRegion(world, everyCellResult, Region { 0, 0, width, height }, activity);
+    std::swap(world.Cells, everyCellResult.Cells);
+
+    // a cell that can't move after a complete step stays where it is until something below it moves away
+    activateMovableCells(world);
+    return cellsChanged;
+}
+
+void ActiveParticleSimulation::activateMovableCells(const World& world)
+{
+    // Every cell of the world is looked at, so a row is first classified without branching on its (often random)
+    // contents and then compacted into the list. Everything the loops use is local, byte stores could alias the members
+    // otherwise and the loops wouldn't be vectorized.
+    const ptrdiff_t rowLength = width;
+    const Cell* const cells = world.Cells.data();
+    active.resize(world.Cells.size());
+    isMovableRow.resize(rowLength);
+    std::uint32_t* const list = active.data();
+    std::uint8_t* const isMovableInRow = isMovableRow.data();
+    size_t count = 0;
+    for (ptrdiff_t y = height - 2; y >= 0; --y) {
+        const Cell* const row = cells + (y * rowLength);
+        const Cell* const below = row + rowLength;
+        for (ptrdiff_t x = 1; x < (rowLength - 1); ++x) {
+            isMovableInRow[x] = isMovable(row[x], isFallable(below[x]), isFallable(below[x + 1]), isFallable(below[x - 1]));
+        }
+        // nothing can slide out of the world
+        const ptrdiff_t last = rowLength - 1;
+        isMovableInRow[last] = isMovable(row[last], isFallable(below[last]), 0, (last > 0) ? isFallable(below[last - 1]) : 0);
+        if (last > 0) {
+            isMovableInRow[0] = isMovable(row[0], isFallable(below[0]), isFallable(below[1]), 0);
+        }
+        for (ptrdiff_t x = rowLength - 1; x >= 0; --x) {
+            list[count] = static_cast<std::uint32_t>((y * rowLength) + x);
+            count += isMovableInRow[x];
+        }
+    }
+    active.resize(count);
+    for (const std::uint32_t index : active) {
+        queuedForStep[index] = nextStep;
+    }
+}
+
+void ActiveParticleSimulation::setRectangle(World& world, const Point& center, const SimulationSettings& settings)
+{
+    const Point worldSize(width, height);
+    ::setRectangle(world, center, worldSize, settings);
+    regionChanged(world, getRectangleRegion(center, worldSize, settings));
+}
+
+void ActiveParticleSimulation::regionChanged(const World& world, const Region& region)
+{
+    for (ptrdiff_t y = region.top; y < region.bottom; ++y) {
+        for (ptrdiff_t x = region.left; x < region.right; ++x) {
+            activateAround(world, (y * width) + x);
+        }
+    }
+}
+
+void ActiveParticleSimulation::update(World& world, const World& newWorld)
+{
+    if ((newWorld.Width != world.Width) || (newWorld.Cells.size() != world.Cells.size())) {
+        world = newWorld;
+        *this = ActiveParticleSimulation(world);
+        return;
+    }
+
+    // unchanged worlds are the common case, so blocks are compared with memcmp first
+    constexpr size_t BlockSize = 256;
+    for (size_t block = 0; block < world.Cells.size(); block += BlockSize) {
+        const size_t end = std::min(block + BlockSize, world.Cells.size());
+        if (std::memcmp(&world.Cells[block], &newWorld.Cells[block], (end - block) * sizeof(Cell)) == 0) {
+            continue;
+        }
+        for (size_t i = block; i < end; ++i) {
+            if (world.Cells[i] != newWorld.Cells[i]) {
+                world.Cells[i] = newWorld.Cells[i];
+                activateAround(world, i);
+            }
+        }
+    }
+}
+
+void ActiveParticleSimulation::activateAround(const World& world, const size_t index)
+{
+    activate(world, index);
+    const size_t rowLength = width;
+    if (index < rowLength) {
+        return;
+    }
+    const size_t x = index % rowLength;
+    activate(world, index - rowLength);
+    if (x > 0) {
+        activate(world, index - rowLength - 1);
+    }
+    if ((x + 1) < rowLength) {
+        activate(world, index - rowLength + 1);
+    }
+}
+
+void ActiveParticleSimulation::activate(const World& world, const size_t index)
+{
+    if ((queuedForStep[index] != nextStep) && canMove(world.Cells[index])) {
+        queuedForStep[index] = nextStep;
+        activatedFromOutside.push_back(static_cast<std::uint32_t>(index));
+    }
+}
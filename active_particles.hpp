@@ -0,0 +1,61 @@
+#pragma once
+#include "simulation.hpp"
+#include <cstdint>
+#include <vector>
+
+// Simulates a World in place by only visiting the cells that may move. It gives exactly the same results as
+// simulateStep, but the cost of a step is proportional to the number of moving particles instead of the size of the
+// world.
+//
+// Cells are processed in the same order as in simulateStep (from the last cell to the first one). A cell only ever
+// falls to a higher index, so every cell still has its old value when it is processed and the world can be updated in
+// place. A Snow or Sand cell that can't move stays inactive until one of the cells below it moves away.
+//
+// The simulation doesn't own the world. Every call has to get the world it was created for, and changes made to the
+// world outside of step() have to be reported with setRectangle, regionChanged or update.
+class ActiveParticleSimulation {
+public:
+    explicit ActiveParticleSimulation(const World& world);
+
+    size_t getActiveCells() const;
+
+    // activity may be nullptr, otherwise the changed cells are added to it
+    CellsChanged step(World& world, ActivityMap* activity);
+
+    // Like ::setRectangle, but also activates the painted cells and their neighbours.
+    void setRectangle(World& world, const Point& center, const SimulationSettings& settings);
+
+    // Activates the cells of `region` and the cells above it, after they were changed outside of the simulation.
+    void regionChanged(const World& world, const Region& region);
+
+    // Copies the cells of `newWorld` into `world` and only activates the ones that are different.
+    void update(World& world, const World& newWorld);
+
+private:
+    // Above this share of active cells (1 / MaximumActiveShare) it is faster to simulate every cell with the kernels and
+    // to look for the cells that can still move afterwards.
+    static constexpr size_t MaximumActiveShare = 8;
+
+    CellsChanged stepEveryCell(World& world, ActivityMap* activity);
+    // replaces the candidates with every cell that can move right now
+    void activateMovableCells(const World& world);
+
+    // the cell itself and the cells above it that could fall into it
+    void activateAround(const World& world, size_t index);
+    void activate(const World& world, size_t index);
+
+    ptrdiff_t width;
+    ptrdiff_t height;
+    // The candidates for the next step, sorted from the last cell to the first one. Cells that were activated from
+    // outside are collected separately and merged in at the start of the next step.
+    std::vector<std::uint32_t> active;
+    std::vector<std::uint32_t> activatedFromOutside;
+    // reused between steps, so that stepping doesn't allocate
+    std::vector<std::uint32_t> processing;
+    std::vector<std::uint32_t> wokenUp;
+    std::vector<std::uint8_t> isMovableRow;
+    // the step a cell was last queued for, so that no cell is queued twice
+    std::vector<std::uint32_t> queuedForStep;
+    std::uint32_t nextStep = 1;
+    World everyCellResult;
+};
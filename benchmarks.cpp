@@ -1,6 +1,21 @@
+#include "active_particles.hpp"
+#include "engine.hpp"
+#include "ensemble.hpp"
+#include "kernels.hpp"
 #include "simulation.hpp"
 #include <benchmark/benchmark.h>
 
+static World createWallGrid(const Point& worldSize)
+{
+    World world(worldSize, Cell::Snow);
+    for (ptrdiff_t y = 0; y < worldSize.y; y += 8) {
+        for (ptrdiff_t x = 0; x < worldSize.x; ++x) {
+            world.Cells[(y * worldSize.x) + x] = Cell::Wall;
+        }
+    }
+    return world;
+}
+
 static void BM_simulateStep(benchmark::State& state)
 {
     const Point worldSize(500, 500);
@@ -11,4 +26,130 @@ static void BM_simulateStep(benchmark::State& state)
 }
 BENCHMARK(BM_simulateStep)->Unit(benchmark::kMillisecond);
 
-BENCHMARK_MAIN();
+static void BM_simulateStepActivity(benchmark::State& state)
+{
+    const Point worldSize(1200, 800);
+    const World input = createRandomWorld(worldSize, 1);
+    ActivityMap activity(worldSize);
+    ActivityMap* const counters = (state.range(0) != 0) ? &activity : nullptr;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(simulateStep(input, counters));
+    }
+}
+BENCHMARK(BM_simulateStepActivity)->ArgName("activity")->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+// A wall with a few shafts, each with a single snow flake that falls into an eraser at the bottom.
+static World createShafts(const Point& worldSize, const ptrdiff_t numberOfShafts)
+{
+    World world(worldSize, Cell::Wall);
+    for (ptrdiff_t shaft = 0; shaft < numberOfShafts; ++shaft) {
+        const ptrdiff_t x = shaft * worldSize.x / numberOfShafts;
+        for (ptrdiff_t y = 0; y < worldSize.y; ++y) {
+            world.Cells[(y * worldSize.x) + x] = Cell::Air;
+        }
+        world.Cells[x] = Cell::Snow;
+        world.Cells[((worldSize.y - 1) * worldSize.x) + x] = Cell::Eraser;
+    }
+    return world;
+}
+
+static void BM_activeParticles(benchmark::State& state)
+{
+    const World input = createShafts(Point(1200, 800), state.range(0));
+    World world = input;
+    ActiveParticleSimulation simulation(world);
+    for (auto _ : state) {
+        // starts over once all flakes are erased
+        if (simulation.step(world, nullptr) == 0) {
+            state.PauseTiming();
+            world = input;
+            simulation = ActiveParticleSimulation(world);
+            state.ResumeTiming();
+        }
+    }
+}
+BENCHMARK(BM_activeParticles)->RangeMultiplier(4)->Range(1, 1024)->Unit(benchmark::kMicrosecond);
+
+static void BM_engine(benchmark::State& state, const EngineDescription& description, const World& input)
+{
+    // the first steps of the scenario, stepped in place like in the GUI
+    constexpr size_t StepsPerRun = 100;
+    const std::unique_ptr<SimulationEngine> engine = description.create();
+    World world = input;
+    size_t steps = StepsPerRun;
+    for (auto _ : state) {
+        if (steps == StepsPerRun) {
+            state.PauseTiming();
+            world = input;
+            engine->worldReplaced(world);
+            steps = 0;
+            state.ResumeTiming();
+        }
+        benchmark::DoNotOptimize(engine->stepInPlace(world, nullptr));
+        ++steps;
+    }
+}
+
+static void BM_simulateRegionKernel(benchmark::State& state, const KernelVariant& variant, const World& input)
+{
+    const ptrdiff_t worldWidth = input.Width;
+    const Region everything { 0, 0, worldWidth, static_cast<ptrdiff_t>(input.Cells.size()) / worldWidth };
+    World output(Point(worldWidth, everything.bottom), Cell::Air);
+    for (auto _ : state) {
+        std::fill(output.Cells.begin(), output.Cells.end(), Cell::Air);
+        benchmark::DoNotOptimize(variant.kernels.simulateRegion(input.Cells.data(), output.Cells.data(), worldWidth, input.Cells.size(), everything, nullptr, 0));
+    }
+}
+
+static void BM_renderCellsKernel(benchmark::State& state, const KernelVariant& variant, const World& input)
+{
+    std::vector<std::uint8_t> pixels(input.Cells.size() * 4);
+    for (auto _ : state) {
+        variant.kernels.renderCells(input.Cells.data(), input.Cells.size(), pixels.data());
+        benchmark::DoNotOptimize(pixels.data());
+    }
+}
+
+static void BM_runEnsemble(benchmark::State& state)
+{
+    std::vector<World> worlds;
+    for (unsigned seed = 0; seed < 256; ++seed) {
+        worlds.push_back(createRandomWorld(Point(64, 64), seed));
+    }
+    EnsembleSettings settings;
+    settings.maximumSteps = 100;
+    settings.numberOfThreads = static_cast<size_t>(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(runEnsemble(worlds, settings));
+    }
+}
+BENCHMARK(BM_runEnsemble)->RangeMultiplier(2)->Range(1, 16)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+int main(int argc, char** argv)
+{
+    const std::vector<std::pair<std::string, World>> scenarios = {
+        { "snow", World(Point(500, 500), Cell::Snow) },
+        { "wall_grid", createWallGrid(Point(500, 500)) },
+        { "random", createRandomWorld(Point(500, 500), 1) },
+    };
+    for (const EngineDescription& description : getEngines()) {
+        for (const auto& [scenario, input] : scenarios) {
+            benchmark::RegisterBenchmark(("BM_engine/" + description.name + "/" + scenario).c_str(), BM_engine, description, input)
+                ->Unit(benchmark::kMillisecond);
+        }
+    }
+
+    const World randomWorld = createRandomWorld(Point(1200, 800), 1);
+    for (const KernelVariant& variant : getKernelVariants()) {
+        if (!variant.isSupported) {
+            continue;
+        }
+        benchmark::RegisterBenchmark((std::string("BM_simulateRegionKernel/") + variant.name).c_str(), BM_simulateRegionKernel, variant, randomWorld)
+            ->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark((std::string("BM_renderCellsKernel/") + variant.name).c_str(), BM_renderCellsKernel, variant, randomWorld)
+            ->Unit(benchmark::kMillisecond);
+    }
+
+    benchmark::Initialize(&argc, argv);
+    benchmark::RunSpecifiedBenchmarks();
+}
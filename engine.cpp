@@ -0,0 +1,258 @@
+#include "engine.hpp"
+#include "active_particles.hpp"
+#include "transition_cache.hpp"
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+
+EngineStatistics SimulationEngine::getStatistics() const
+{
+    return {};
+}
+
+CellsChanged SimulationEngine::stepInPlace(World& world, ActivityMap* activity)
+{
+    std::pair<CellsChanged, World> result = step(world, activity);
+    world = std::move(result.second);
+    return result.first;
+}
+
+void SimulationEngine::regionChanged(const World&, const Region&)
+{
+}
+
+void SimulationEngine::worldReplaced(const World&)
+{
+}
+
+namespace {
+class ReferenceEngine : public SimulationEngine {
+public:
+    std::pair<CellsChanged, World> step(const World& world, ActivityMap* activity) override
+    {
+        return simulateStep(world, activity);
+    }
+};
+
+class TransitionCacheEngine : public SimulationEngine {
+public:
+    std::pair<CellsChanged, World> step(const World& world, ActivityMap* activity) override
+    {
+        return simulateStepCached(world, cache, activity);
+    }
+
+    EngineStatistics getStatistics() const override
+    {
+        return {
+            { "Chunk cache hits", cache.getHits() },
+            { "Chunk cache misses", cache.getMisses() },
+            { "Chunk cache size", cache.getSize() },
+        };
+    }
+
+private:
+    TransitionCache cache { 16384 };
+};
+
+// Steps the world in place as long as all changes from outside are reported. step() gets arbitrary worlds, so it keeps
+// its own copy of the last result and compares every new world with it.
+class ActiveParticleEngine : public SimulationEngine {
+public:
+    std::pair<CellsChanged, World> step(const World& world, ActivityMap* activity) override
+    {
+        if (simulation && lastResult) {
+            simulation->update(*lastResult, world);
+        } else {
+            lastResult = world;
+            simulation.emplace(*lastResult);
+        }
+        const CellsChanged cellsChanged = simulation->step(*lastResult, activity);
+        return { cellsChanged, *lastResult };
+    }
+
+    CellsChanged stepInPlace(World& world, ActivityMap* activity) override
+    {
+        if (!simulation || lastResult) {
+            lastResult.reset();
+            simulation.emplace(world);
+        }
+        return simulation->step(world, activity);
+    }
+
+    void regionChanged(const World& world, const Region& region) override
+    {
+        if (simulation && !lastResult) {
+            simulation->regionChanged(world, region);
+        }
+    }
+
+    void worldReplaced(const World&) override
+    {
+        simulation.reset();
+        lastResult.reset();
+    }
+
+    EngineStatistics getStatistics() const override
+    {
+        return {
+            { "Active cells", simulation ? simulation->getActiveCells() : 0 },
+        };
+    }
+
+private:
+    std::optional<ActiveParticleSimulation> simulation;
+    // only used by step()
+    std::optional<World> lastResult;
+};
+}
+
+const std::vector<EngineDescription>& getEngines()
+{
+    static const std::vector<EngineDescription> engines = {
+        { "Reference", [] { return std::make_unique<ReferenceEngine>(); } },
+        { "Chunk cache", [] { return std::make_unique<TransitionCacheEngine>(); } },
+        { "Active particles", [] { return std::make_unique<ActiveParticleEngine>(); } },
+    };
+    return engines;
+}
+
+std::unique_ptr<SimulationEngine> createEngine(const std::string& name)
+{
+    for (const EngineDescription& engine : getEngines()) {
+        if (engine.name == name) {
+            return engine.create();
+        }
+    }
+    throw std::invalid_argument("Unknown simulation engine: " + name);
+}
+
+std::ostream& operator<<(std::ostream& out, const Divergence& value)
+{
+    if (value.position) {
+        out << "cell (" << value.position->x << ", " << value.position->y << ") is '" << CellToChar(value.actual)
+            << "' instead of '" << CellToChar(value.expected) << "'";
+    } else {
+        out << value.actualCellsChanged << " cells changed instead of " << value.expectedCellsChanged;
+    }
+    return out;
+}
+
+std::optional<Divergence> findDivergence(const std::pair<CellsChanged, World>& expected, const std::pair<CellsChanged, World>& actual)
+{
+    const World& expectedWorld = expected.second;
+    const World& actualWorld = actual.second;
+    if ((expectedWorld.Width != actualWorld.Width) || (expectedWorld.Cells.size() != actualWorld.Cells.size())) {
+        throw std::invalid_argument("Worlds of different sizes can't be compared");
+    }
+
+    for (size_t i = 0; i < expectedWorld.Cells.size(); ++i) {
+        if (expectedWorld.Cells[i] != actualWorld.Cells[i]) {
+            const Point position(i % expectedWorld.Width, i / expectedWorld.Width);
+            return Divergence { position, expectedWorld.Cells[i], actualWorld.Cells[i], expected.first, actual.first };
+        }
+    }
+    if (expected.first != actual.first) {
+        return Divergence { std::nullopt, Cell::Air, Cell::Air, expected.first, actual.first };
+    }
+    return std::nullopt;
+}
+
+VerifyingEngine::VerifyingEngine(std::unique_ptr<SimulationEngine> candidate)
+    : candidate(std::move(candidate))
+{
+}
+
+std::pair<CellsChanged, World> VerifyingEngine::step(const World& world, ActivityMap* activity)
+{
+    candidateWorld.reset();
+    std::pair<CellsChanged, World> expected = simulateStep(world, activity);
+    if (!firstDivergence) {
+        firstDivergence = findDivergence(expected, candidate->step(world, nullptr));
+        if (!firstDivergence) {
+            ++stepsVerified;
+        }
+    }
+    return expected;
+}
+
+CellsChanged VerifyingEngine::stepInPlace(World& world, ActivityMap* activity)
+{
+    std::pair<CellsChanged, World> expected = simulateStep(world, activity);
+    if (!firstDivergence) {
+        if (!candidateWorld) {
+            candidateWorld = world;
+            candidate->worldReplaced(*candidateWorld);
+        }
+        const CellsChanged cellsChanged = candidate->stepInPlace(*candidateWorld, nullptr);
+        firstDivergence = findDivergence(expected, { cellsChanged, *candidateWorld });
+        if (!firstDivergence) {
+            ++stepsVerified;
+        }
+    }
+    world = std::move(expected.second);
+    return expected.first;
+}
+
+void VerifyingEngine::regionChanged(const World& world, const Region& region)
+{
+    if (!candidateWorld) {
+        return;
+    }
+    for (ptrdiff_t y = region.top; y < region.bottom; ++y) {
+        const size_t rowStart = (y * world.Width);
+        std::copy(world.Cells.begin() + rowStart + region.left, world.Cells.begin() + rowStart + region.right, candidateWorld->Cells.begin() + rowStart + region.left);
+    }
+    candidate->regionChanged(*candidateWorld, region);
+}
+
+void VerifyingEngine::worldReplaced(const World&)
+{
+    candidateWorld.reset();
+}
+
+EngineStatistics VerifyingEngine::getStatistics() const
+{
+    EngineStatistics statistics = candidate->getStatistics();
+    statistics.emplace_back("Steps verified", stepsVerified);
+    return statistics;
+}
+
+const std::optional<Divergence>& VerifyingEngine::getFirstDivergence() const
+{
+    return firstDivergence;
+}
+
+World createRandomWorld(const Point& size, const unsigned seed)
+{
+    std::mt19937 random(seed);
+
+    // every world gets its own mix of materials, so that sparse and dense worlds are both covered
+    std::uniform_int_distribution<int> weight(0, 8);
+    std::discrete_distribution<int> material({ 1.0 + weight(random),
+        static_cast<double>(weight(random)),
+        static_cast<double>(weight(random)),
+        static_cast<double>(weight(random)),
+        static_cast<double>(weight(random)) });
+
+    World world(size, Cell::Air);
+    for (Cell& cell : world.Cells) {
+        cell = static_cast<Cell>(material(random));
+    }
+    return world;
+}
+
+std::optional<Divergence> verifyOnRandomWorlds(SimulationEngine& candidate, const Point& size, const size_t numberOfWorlds, const size_t stepsPerWorld, const unsigned seed)
+{
+    for (size_t i = 0; i < numberOfWorlds; ++i) {
+        World world = createRandomWorld(size, static_cast<unsigned>(seed + i));
+        for (size_t step = 0; step < stepsPerWorld; ++step) {
+            std::pair<CellsChanged, World> expected = simulateStep(world);
+            const std::optional<Divergence> divergence = findDivergence(expected, candidate.step(world, nullptr));
+            if (divergence) {
+                return divergence;
+            }
+            world = std::move(expected.second);
+        }
+    }
+    return std::nullopt;
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include "simulation.hpp"
+#include <functional>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Counters an engine wants to show in the profiling panel, e.g. cache hits.
+using EngineStatistics = std::vector<std::pair<std::string, size_t>>;
+
+// One way of advancing a World by a single step. Every engine has to produce exactly the same result as simulateStep.
+class SimulationEngine {
+public:
+    virtual ~SimulationEngine() = default;
+
+    // activity may be nullptr, otherwise the changed cells are added to it
+    virtual std::pair<CellsChanged, World> step(const World& world, ActivityMap* activity) = 0;
+    virtual EngineStatistics getStatistics() const;
+
+    // Steps `world` in place, which lets an engine avoid touching cells that don't change. Between two calls the world
+    // may only be changed in ways that are reported with regionChanged or worldReplaced.
+    // The default implementation calls step().
+    virtual CellsChanged stepInPlace(World& world, ActivityMap* activity);
+    // The cells of `region` were changed outside of the engine, e.g. by painting.
+    virtual void regionChanged(const World& world, const Region& region);
+    // The whole world was changed outside of the engine, e.g. by loading a file.
+    virtual void worldReplaced(const World& world);
+};
+
+struct EngineDescription {
+    std::string name;
+    std::function<std::unique_ptr<SimulationEngine>()> create;
+};
+
+// All available engines. The first one is the reference engine that calls simulateStep.
+const std::vector<EngineDescription>& getEngines();
+std::unique_ptr<SimulationEngine> createEngine(const std::string& name);
+
+struct Divergence {
+    // nullopt if the worlds are equal and only the number of changed cells differs
+    std::optional<Point> position;
+    Cell expected;
+    Cell actual;
+    CellsChanged expectedCellsChanged;
+    CellsChanged actualCellsChanged;
+};
+
+std::ostream& operator<<(std::ostream& out, const Divergence& value);
+
+std::optional<Divergence> findDivergence(const std::pair<CellsChanged, World>& expected, const std::pair<CellsChanged, World>& actual);
+
+// Runs `candidate` alongside the reference engine and remembers the first divergence. The reference result is returned,
+// so a broken candidate can't corrupt a running session. When stepping in place, the candidate steps its own copy of the
+// world.
+class VerifyingEngine : public SimulationEngine {
+public:
+    explicit VerifyingEngine(std::unique_ptr<SimulationEngine> candidate);
+
+    std::pair<CellsChanged, World> step(const World& world, ActivityMap* activity) override;
+    EngineStatistics getStatistics() const override;
+    CellsChanged stepInPlace(World& world, ActivityMap* activity) override;
+    void regionChanged(const World& world, const Region& region) override;
+    void worldReplaced(const World& world) override;
+
+    const std::optional<Divergence>& getFirstDivergence() const;
+
+private:
+    std::unique_ptr<SimulationEngine> candidate;
+    // nullopt until the first step in place after the world was replaced
+    std::optional<World> candidateWorld;
+    size_t stepsVerified = 0;
+    std::optional<Divergence> firstDivergence;
+};
+
+World createRandomWorld(const Point& size, unsigned seed);
+
+// Steps random worlds of `size` with both `candidate` and simulateStep.
+std::optional<Divergence> verifyOnRandomWorlds(SimulationEngine& candidate, const Point& size, size_t numberOfWorlds, size_t stepsPerWorld, unsigned seed);
@@ -0,0 +1,153 @@
+#include "ensemble.hpp"
+#include "kernels.hpp"
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace {
+// The worlds are handed out round robin. A thread takes work from the back of its own queue and steals from the front
+// of the others when it runs out, so a few slow worlds don't keep the other cores idle.
+class WorkQueue {
+public:
+    void push(const size_t task)
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(task);
+    }
+
+    std::optional<size_t> pop()
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        if (tasks.empty()) {
+            return std::nullopt;
+        }
+        const size_t task = tasks.back();
+        tasks.pop_back();
+        return task;
+    }
+
+    std::optional<size_t> steal()
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        if (tasks.empty()) {
+            return std::nullopt;
+        }
+        const size_t task = tasks.front();
+        tasks.pop_front();
+        return task;
+    }
+
+private:
+    std::mutex mutex;
+    std::deque<size_t> tasks;
+};
+
+struct Member {
+    // two buffers of numberOfCells each in the arena, the current state is in the first one after an even number of steps
+    size_t arenaOffset;
+    size_t numberOfCells;
+    ptrdiff_t width;
+    size_t steps = 0;
+    bool isSettled = false;
+    CellsChanged totalCellsChanged = 0;
+    std::optional<ActivityMap> activity;
+};
+
+void runMember(Member& member, Cell* const arena, const Kernels& kernels, const EnsembleSettings& settings)
+{
+    if (member.width == 0) {
+        member.isSettled = true;
+        return;
+    }
+
+    const ptrdiff_t height = member.numberOfCells / member.width;
+    const Region everything { 0, 0, member.width, height };
+    std::uint32_t* const tileChanges = member.activity ? member.activity->changes.data() : nullptr;
+    const ptrdiff_t tilesPerRow = member.activity ? member.activity->tiles.x : 0;
+
+    Cell* current = arena + member.arenaOffset;
+    Cell* next = current + member.numberOfCells;
+    while (member.steps < settings.maximumSteps) {
+        std::fill(next, next + member.numberOfCells, Cell::Air);
+        const CellsChanged cellsChanged = kernels.simulateRegion(current, next, member.width, member.numberOfCells, everything, tileChanges, tilesPerRow);
+        std::swap(current, next);
+        ++member.steps;
+        member.totalCellsChanged += cellsChanged;
+        if (cellsChanged == 0) {
+            member.isSettled = true;
+            break;
+        }
+    }
+}
+}
+
+std::vector<EnsembleResult> runEnsemble(const std::vector<World>& worlds, const EnsembleSettings& settings)
+{
+    std::vector<Member> members;
+    members.reserve(worlds.size());
+    size_t arenaSize = 0;
+    for (const World& world : worlds) {
+        Member member;
+        member.arenaOffset = arenaSize;
+        member.numberOfCells = world.Cells.size();
+        member.width = world.Width;
+        if (settings.isActivityRecorded && (world.Width != 0)) {
+            member.activity.emplace(Point(member.width, member.numberOfCells / member.width));
+        }
+        members.push_back(std::move(member));
+        arenaSize += (2 * world.Cells.size());
+    }
+
+    std::vector<Cell> arena(arenaSize, Cell::Air);
+    for (size_t i = 0; i < worlds.size(); ++i) {
+        std::copy(worlds[i].Cells.begin(), worlds[i].Cells.end(), arena.begin() + members[i].arenaOffset);
+    }
+
+    size_t numberOfThreads = settings.numberOfThreads;
+    if (numberOfThreads == 0) {
+        numberOfThreads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+    numberOfThreads = std::max<size_t>(1, std::min(numberOfThreads, worlds.size()));
+
+    std::vector<WorkQueue> queues(numberOfThreads);
+    for (size_t i = 0; i < worlds.size(); ++i) {
+        queues[i % numberOfThreads].push(i);
+    }
+
+    const Kernels& kernels = getSelectedKernelVariant().kernels;
+    const auto work = [&](const size_t thread) {
+        for (;;) {
+            std::optional<size_t> task = queues[thread].pop();
+            for (size_t offset = 1; !task && (offset < numberOfThreads); ++offset) {
+                task = queues[(thread + offset) % numberOfThreads].steal();
+            }
+            // nothing creates new work, so empty queues mean that everything is done or being done
+            if (!task) {
+                return;
+            }
+            runMember(members[*task], arena.data(), kernels, settings);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(numberOfThreads - 1);
+    for (size_t thread = 1; thread < numberOfThreads; ++thread) {
+        threads.emplace_back(work, thread);
+    }
+    work(0);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    std::vector<EnsembleResult> results;
+    results.reserve(worlds.size());
+    for (size_t i = 0; i < worlds.size(); ++i) {
+        Member& member = members[i];
+        const size_t finalOffset = member.arenaOffset + (((member.steps % 2) == 0) ? 0 : member.numberOfCells);
+        World world = worlds[i];
+        std::copy(arena.begin() + finalOffset, arena.begin() + finalOffset + member.numberOfCells, world.Cells.begin());
+        results.push_back(EnsembleResult { std::move(world), member.steps, member.isSettled, member.totalCellsChanged, std::move(member.activity) });
+    }
+    return results;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "simulation.hpp"
+#include <optional>
+#include <vector>
+
+struct EnsembleSettings {
+    // a world that hasn't settled after this many steps is stopped anyway
+    size_t maximumSteps = 1000;
+    // 0 uses one thread per hardware thread
+    size_t numberOfThreads = 0;
+    bool isActivityRecorded = false;
+};
+
+struct EnsembleResult {
+    World world;
+    // including the last one, in which nothing changed any more
+    size_t steps;
+    bool isSettled;
+    CellsChanged totalCellsChanged;
+    // only if EnsembleSettings::isActivityRecorded
+    std::optional<ActivityMap> activity;
+};
+
+// Advances many independent worlds on a work-stealing thread pool, until each of them settles or reaches the step
+// limit. The cells of all worlds live in a single arena and are stepped with the reference kernels, so the results are
+// exactly the same as calling simulateStep in a loop. The results are in the same order as the worlds.
+std::vector<EnsembleResult> runEnsemble(const std::vector<World>& worlds, const EnsembleSettings& settings);
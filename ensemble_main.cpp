@@ -0,0 +1,150 @@
+#include "engine.hpp"
+#include "ensemble.hpp"
+#include "simulation.hpp"
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+void printUsage()
+{
+    std::cerr << "usage: ventilation_ensemble [options] [world files...]\n"
+                 "  --width W, --height H  size of the worlds (default: 1200x800 for files, 64x64 for random worlds)\n"
+                 "  --random COUNT         adds COUNT random worlds\n"
+                 "  --seed S               seed of the first random world (default: 1)\n"
+                 "  --steps N              stop worlds that haven't settled after N steps (default: 1000)\n"
+                 "  --threads N            number of threads, 0 for all hardware threads (default: 0)\n"
+                 "  --output DIR           saves the final worlds as world_<index>.dat\n"
+                 "  --activity DIR         saves the activity of every world as activity_<index>.csv\n"
+                 "World files are in the format of File > Save in the GUI.\n";
+}
+
+// Parses an unsigned number that has to fit into `Number`.
+template <typename Number>
+Number parseNumber(const std::string& value)
+{
+    // stoull skips whitespace and accepts signs, negative numbers would wrap around
+    if (value.empty() || (value.front() < '0') || (value.front() > '9')) {
+        throw std::invalid_argument("Not a number: " + value);
+    }
+    size_t end = 0;
+    unsigned long long number = 0;
+    try {
+        number = std::stoull(value, &end);
+    } catch (const std::out_of_range&) {
+        throw std::invalid_argument("Number too large: " + value);
+    }
+    if (end != value.size()) {
+        throw std::invalid_argument("Not a number: " + value);
+    }
+    if (number > std::numeric_limits<Number>::max()) {
+        throw std::invalid_argument("Number too large: " + value);
+    }
+    return static_cast<Number>(number);
+}
+}
+
+int main(int argc, char** argv)
+{
+    EnsembleSettings settings;
+    std::optional<size_t> width;
+    std::optional<size_t> height;
+    size_t numberOfRandomWorlds = 0;
+    unsigned seed = 1;
+    std::optional<std::filesystem::path> outputDirectory;
+    std::optional<std::filesystem::path> activityDirectory;
+    std::vector<std::string> files;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const std::string argument = argv[i];
+            const auto value = [&]() -> std::string {
+                if ((i + 1) >= argc) {
+                    throw std::invalid_argument("Missing value for " + argument);
+                }
+                return argv[++i];
+            };
+            if (argument == "--width") {
+                width = parseNumber<size_t>(value());
+            } else if (argument == "--height") {
+                height = parseNumber<size_t>(value());
+            } else if (argument == "--random") {
+                numberOfRandomWorlds = parseNumber<size_t>(value());
+            } else if (argument == "--seed") {
+                seed = parseNumber<unsigned>(value());
+            } else if (argument == "--steps") {
+                settings.maximumSteps = parseNumber<size_t>(value());
+            } else if (argument == "--threads") {
+                settings.numberOfThreads = parseNumber<size_t>(value());
+            } else if (argument == "--output") {
+                outputDirectory = value();
+            } else if (argument == "--activity") {
+                activityDirectory = value();
+                settings.isActivityRecorded = true;
+            } else if ((argument == "--help") || (argument == "-h")) {
+                printUsage();
+                return 0;
+            } else if (argument.rfind("--", 0) == 0) {
+                throw std::invalid_argument("Unknown option: " + argument);
+            } else {
+                files.push_back(argument);
+            }
+        }
+    } catch (const std::exception& error) {
+        std::cerr << error.what() << '\n';
+        printUsage();
+        return 1;
+    }
+
+    std::vector<World> worlds;
+    const Point fileWorldSize(width.value_or(1200), height.value_or(800));
+    for (const std::string& file : files) {
+        if (!std::filesystem::exists(file)) {
+            std::cerr << "World file not found: " << file << '\n';
+            return 1;
+        }
+        World world(fileWorldSize, Cell::Air);
+        loadWorldFromFile(world, file);
+        worlds.push_back(std::move(world));
+    }
+    const Point randomWorldSize(width.value_or(64), height.value_or(64));
+    for (size_t i = 0; i < numberOfRandomWorlds; ++i) {
+        worlds.push_back(createRandomWorld(randomWorldSize, static_cast<unsigned>(seed + i)));
+    }
+    if (worlds.empty()) {
+        printUsage();
+        return 1;
+    }
+
+    const std::chrono::time_point start = std::chrono::steady_clock::now();
+    const std::vector<EnsembleResult> results = runEnsemble(worlds, settings);
+    const std::chrono::time_point stop = std::chrono::steady_clock::now();
+
+    size_t totalSteps = 0;
+    std::cout << "world,steps,settled,cells_changed,non_empty_cells\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const EnsembleResult& result = results[i];
+        totalSteps += result.steps;
+        std::cout << i << ',' << result.steps << ',' << (result.isSettled ? 1 : 0) << ',' << result.totalCellsChanged << ','
+                  << (result.world.Cells.size() - result.world.getEmptyCells()) << '\n';
+
+        const std::string index = std::to_string(i);
+        if (outputDirectory) {
+            std::filesystem::create_directories(*outputDirectory);
+            saveWorldToFile(result.world, (*outputDirectory / ("world_" + index + ".dat")).string());
+        }
+        if (activityDirectory && result.activity) {
+            std::filesystem::create_directories(*activityDirectory);
+            saveActivityToFile(*result.activity, (*activityDirectory / ("activity_" + index + ".csv")).string());
+        }
+    }
+
+    const double seconds = std::chrono::duration<double>(stop - start).count();
+    std::cerr << results.size() << " worlds, " << totalSteps << " steps in " << seconds << " s ("
+              << (static_cast<double>(totalSteps) / seconds) << " steps/s)\n";
+    return 0;
+}
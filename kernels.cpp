@@ -0,0 +1,109 @@
+#include "kernels.hpp"
+#include <stdexcept>
+
+#if defined(VENT_X86_KERNELS) && defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace baseline {
+extern const Kernels kernels;
+}
+
+#if defined(VENT_X86_KERNELS)
+namespace avx2 {
+extern const Kernels kernels;
+}
+
+namespace avx512 {
+extern const Kernels kernels;
+}
+
+namespace {
+#if defined(_MSC_VER)
+struct CpuFeatures {
+    bool avx2 = false;
+    bool avx512 = false;
+};
+
+CpuFeatures queryCpuFeatures()
+{
+    CpuFeatures features;
+    int registers[4] = {};
+    __cpuid(registers, 0);
+    const int highestLeaf = registers[0];
+    if (highestLeaf < 7) {
+        return features;
+    }
+
+    __cpuid(registers, 1);
+    const bool isXsaveEnabled = (registers[2] & (1 << 27)) != 0;
+    const bool hasAvx = (registers[2] & (1 << 28)) != 0;
+    if (!isXsaveEnabled || !hasAvx) {
+        return features;
+    }
+
+    // the operating system has to save the vector registers on context switches
+    const unsigned long long enabledRegisters = _xgetbv(0);
+    const bool isYmmEnabled = (enabledRegisters & 0x6) == 0x6;
+    const bool isZmmEnabled = (enabledRegisters & 0xE6) == 0xE6;
+
+    __cpuidex(registers, 7, 0);
+    const unsigned extendedFeatures = static_cast<unsigned>(registers[1]);
+    const auto hasFeature = [extendedFeatures](const int bit) { return (extendedFeatures & (1u << bit)) != 0; };
+    features.avx2 = isYmmEnabled && hasFeature(5);
+    // F, DQ, CD, BW and VL are what /arch:AVX512 assumes
+    features.avx512 = isZmmEnabled && hasFeature(16) && hasFeature(17) && hasFeature(28) && hasFeature(30) && hasFeature(31);
+    return features;
+}
+
+bool supportsAvx2()
+{
+    return queryCpuFeatures().avx2;
+}
+
+bool supportsAvx512()
+{
+    return queryCpuFeatures().avx512;
+}
+#else
+bool supportsAvx2()
+{
+    return __builtin_cpu_supports("avx2");
+}
+
+bool supportsAvx512()
+{
+    return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512cd")
+        && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl");
+}
+#endif
+}
+#endif
+
+const std::vector<KernelVariant>& getKernelVariants()
+{
+    static const std::vector<KernelVariant> variants = {
+#if defined(VENT_X86_KERNELS)
+        { "AVX-512", supportsAvx512(), avx512::kernels },
+        { "AVX2", supportsAvx2(), avx2::kernels },
+        { "SSE2", true, baseline::kernels },
+#else
+        { "Baseline", true, baseline::kernels },
+#endif
+    };
+    return variants;
+}
+
+const KernelVariant& getSelectedKernelVariant()
+{
+    static const KernelVariant& selected = []() -> const KernelVariant& {
+        for (const KernelVariant& variant : getKernelVariants()) {
+            if (variant.isSupported) {
+                return variant;
+            }
+        }
+        throw std::logic_error("The baseline kernels are always supported");
+    }();
+    return selected;
+}
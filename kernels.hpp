@@ -0,0 +1,34 @@
+#pragma once
+#include "simulation.hpp"
+#include <cstdint>
+#include <vector>
+
+// RGBA color of every Cell, indexed by the value of the Cell
+inline constexpr std::uint8_t CellColors[5][4] = {
+    { 0, 0, 0, 255 },
+    { 255, 255, 255, 255 },
+    { 128, 128, 128, 255 },
+    { 180, 110, 0, 255 },
+    { 255, 0, 0, 255 },
+};
+
+// The hot loops of the simulation and the renderer. They are compiled once per instruction set and only work on plain
+// pointers, so that no inline standard library code gets compiled with instructions the CPU might not support.
+struct Kernels {
+    // tileChanges may be nullptr, otherwise it points to ActivityMap::changes
+    CellsChanged (*simulateRegion)(const Cell* oldWorld, Cell* newWorld, ptrdiff_t worldWidth, size_t numberOfCells, const Region& region, std::uint32_t* tileChanges, ptrdiff_t tilesPerRow);
+    // writes 4 bytes (RGBA) per cell into pixels
+    void (*renderCells)(const Cell* cells, size_t numberOfCells, std::uint8_t* pixels);
+};
+
+struct KernelVariant {
+    const char* name;
+    bool isSupported;
+    Kernels kernels;
+};
+
+// All variants compiled into this binary, from the most to the least advanced instruction set.
+const std::vector<KernelVariant>& getKernelVariants();
+
+// The most advanced variant that this CPU supports. It is selected once on the first call.
+const KernelVariant& getSelectedKernelVariant();
@@ -0,0 +1,163 @@
+// Included by the kernels_*.cpp files with VENT_KERNEL_NAMESPACE set to a unique name for every instruction set.
+// Don't call inline functions of the standard library in here. The linker may keep any one of their copies, including
+// the one compiled for an instruction set that the CPU doesn't support.
+#include "kernels.hpp"
+#include <cassert>
+#include <cstring>
+
+namespace VENT_KERNEL_NAMESPACE {
+namespace {
+    bool canFallInto(const Cell into)
+    {
+        switch (into) {
+        case Cell::Air:
+        case Cell::Eraser:
+            return true;
+        case Cell::Snow:
+        case Cell::Sand:
+        case Cell::Wall:
+            return false;
+        }
+        VENT_UNREACHABLE();
+    }
+
+    [[nodiscard]] Cell fall(const Cell top, const Cell bottom)
+    {
+        assert(canFallInto(bottom));
+        switch (bottom) {
+        case Cell::Air:
+            return top;
+
+        case Cell::Eraser:
+            return bottom;
+
+        case Cell::Snow:
+        case Cell::Sand:
+        case Cell::Wall:
+            VENT_UNREACHABLE();
+        }
+        VENT_UNREACHABLE();
+    }
+
+    // The activity counters are a template parameter, so that the loop without them is not slowed down by them.
+    template <bool isCountingActivity>
+    CellsChanged simulateRows(const Cell* const oldWorld, Cell* const newWorld, const ptrdiff_t worldWidth, const size_t numberOfCells, const Region& region, std::uint32_t* const tileChanges, const ptrdiff_t tilesPerRow)
+    {
+        size_t cellsChanged = 0;
+        for (ptrdiff_t y = (region.bottom - 1); y >= region.top; --y) {
+            size_t cellIndex = (y * worldWidth) + region.right;
+            std::uint32_t* const tileRow = isCountingActivity ? (tileChanges + ((y / ActivityTileSize) * tilesPerRow)) : nullptr;
+            size_t countedCellsChanged = cellsChanged;
+            for (ptrdiff_t x = (region.right - 1); x >= region.left; --x) {
+                --cellIndex;
+                const Cell& cell = oldWorld[cellIndex];
+                switch (cell) {
+                case Cell::Air:
+                    // the counters at the end of the loop still have to be updated
+                    if constexpr (!isCountingActivity) {
+                        continue;
+                    }
+                    break;
+
+                case Cell::Snow: {
+                    const size_t belowIndex = (cellIndex + worldWidth);
+                    if ((belowIndex < numberOfCells) && canFallInto(newWorld[belowIndex])) {
+                        newWorld[cellIndex] = Cell::Air;
+                        newWorld[belowIndex] = fall(cell, newWorld[belowIndex]);
+                        cellsChanged++;
+                    } else {
+                        newWorld[cellIndex] = cell;
+                    }
+                    break;
+                }
+
+                case Cell::Sand: {
+                    const size_t belowIndex = (cellIndex + worldWidth);
+                    if (belowIndex < numberOfCells) {
+                        if (canFallInto(newWorld[belowIndex])) {
+                            newWorld[cellIndex] = Cell::Air;
+                            newWorld[belowIndex] = fall(cell, newWorld[belowIndex]);
+                            cellsChanged++;
+                            break;
+                        }
+
+                        const bool isWithinBounds[2] = {
+                            (x < (worldWidth - 1)),
+                            (x > 0)
+                        };
+
+                        static constexpr ptrdiff_t horizontalOffsets[2] = {
+                            1,
+                            -1
+                        };
+
+                        bool fellToTheSide = false;
+                        for (size_t i = 0; i < 2; ++i) {
+                            if (!isWithinBounds[i]) {
+                                continue;
+                            }
+                            const size_t belowLeftRightIndex = (belowIndex + horizontalOffsets[i]);
+                            if (canFallInto(newWorld[belowLeftRightIndex])) {
+                                newWorld[cellIndex] = Cell::Air;
+                                newWorld[belowLeftRightIndex] = fall(cell, newWorld[belowLeftRightIndex]);
+                                fellToTheSide = true;
+                                cellsChanged++;
+                                break;
+                            }
+                        }
+                        if (fellToTheSide) {
+                            break;
+                        }
+                    }
+
+                    newWorld[cellIndex] = cell;
+                    break;
+                }
+
+                case Cell::Wall:
+                case Cell::Eraser:
+                    newWorld[cellIndex] = cell;
+                    break;
+                }
+                // the counters are only touched once per tile and row
+                if constexpr (isCountingActivity) {
+                    if (((x % ActivityTileSize) == 0) || (x == region.left)) {
+                        tileRow[x / ActivityTileSize] += static_cast<std::uint32_t>(cellsChanged - countedCellsChanged);
+                        countedCellsChanged = cellsChanged;
+                    }
+                }
+            }
+        }
+        return cellsChanged;
+    }
+
+    CellsChanged simulateRegion(const Cell* const oldWorld, Cell* const newWorld, const ptrdiff_t worldWidth, const size_t numberOfCells, const Region& region, std::uint32_t* const tileChanges, const ptrdiff_t tilesPerRow)
+    {
+        if (tileChanges == nullptr) {
+            return simulateRows<false>(oldWorld, newWorld, worldWidth, numberOfCells, region, nullptr, 0);
+        }
+        return simulateRows<true>(oldWorld, newWorld, worldWidth, numberOfCells, region, tileChanges, tilesPerRow);
+    }
+
+    void renderCells(const Cell* const cells, const size_t numberOfCells, std::uint8_t* const pixels)
+    {
+        std::uint32_t palette[5];
+        std::memcpy(palette, CellColors, sizeof(palette));
+
+        // Selects the color with comparisons instead of indexing the palette. Table lookups would need gather
+        // instructions, comparisons and masks vectorize with every instruction set.
+        for (size_t i = 0; i < numberOfCells; ++i) {
+            const std::uint8_t cell = static_cast<std::uint8_t>(cells[i]);
+            std::uint32_t pixel = 0;
+            for (std::uint32_t material = 0; material < 5; ++material) {
+                // all bits set if the cell is of this material
+                const std::uint32_t mask = 0u - static_cast<std::uint32_t>(cell == material);
+                pixel |= (palette[material] & mask);
+            }
+            std::memcpy(pixels + (i * 4), &pixel, 4);
+        }
+    }
+}
+
+extern const Kernels kernels = { simulateRegion, renderCells };
+}
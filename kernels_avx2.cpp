@@ -0,0 +1,3 @@
+// Compiled with AVX2 enabled, see CMakeLists.txt
+#define VENT_KERNEL_NAMESPACE avx2
+#include "kernels.inl"
@@ -0,0 +1,3 @@
+// Compiled with AVX-512 (F, CD, BW, DQ, VL) enabled, see CMakeLists.txt
+#define VENT_KERNEL_NAMESPACE avx512
+#include "kernels.inl"
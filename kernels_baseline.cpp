@@ -0,0 +1,3 @@
+// The kernels for the instruction set the whole project is compiled for (SSE2 on x86-64).
+#define VENT_KERNEL_NAMESPACE baseline
+#include "kernels.inl"
@@ -1,6 +1,7 @@
 #include "main.hpp"
 #include "imgui-SFML.h"
 #include "imgui.h"
+#include "kernels.hpp"
 #include "own_imgui.hpp"
 #include "simulation.hpp"
 #include <SFML/Graphics/CircleShape.hpp>
@@ -9,28 +10,12 @@
 #include <SFML/Graphics/Texture.hpp>
 #include <SFML/System/Clock.hpp>
 #include <SFML/Window/Event.hpp>
+#include <algorithm>
 #include <array>
+#include <cassert>
 #include <chrono>
-#include <fstream>
 #include <iostream>
 
-sf::Color renderCell(const Cell& cell)
-{
-    switch (cell) {
-    case Cell::Air:
-        return sf::Color(0, 0, 0, 255);
-    case Cell::Snow:
-        return sf::Color(255, 255, 255, 255);
-    case Cell::Wall:
-        return sf::Color(128, 128, 128, 255);
-    case Cell::Sand:
-        return sf::Color(180, 110, 0, 255);
-    case Cell::Eraser:
-        return sf::Color(255, 0, 0, 255);
-    }
-    VENT_UNREACHABLE();
-}
-
 void renderWorld(sf::Image& into, const Cell& front, const Point& worldSize)
 {
     assert(static_cast<ptrdiff_t>(into.getSize().x) == worldSize.x);
@@ -40,31 +25,61 @@ void renderWorld(sf::Image& into, const Cell& front, const Point& worldSize)
     sf::Uint8* const pixels = const_cast<sf::Uint8*>(into.getPixelsPtr());
 
     const size_t numberOfCells = (worldSize.x * worldSize.y);
-    for (size_t i = 0; i < numberOfCells; ++i) {
-        const sf::Color cellColor = renderCell((&front)[i]);
-        sf::Uint8* const cellPixel = pixels + (i * 4);
-        cellPixel[0] = cellColor.r;
-        cellPixel[1] = cellColor.g;
-        cellPixel[2] = cellColor.b;
-        cellPixel[3] = cellColor.a;
+    getSelectedKernelVariant().kernels.renderCells(&front, numberOfCells, pixels);
+}
+
+void renderHeatMap(sf::Image& into, const std::vector<float>& heat, const Point& tiles, const Point& worldSize)
+{
+    const float maximumHeat = *std::max_element(heat.begin(), heat.end());
+    if (maximumHeat <= 0.0f) {
+        return;
+    }
+
+    // pixels are marked const for some reason
+    sf::Uint8* const pixels = const_cast<sf::Uint8*>(into.getPixelsPtr());
+
+    for (ptrdiff_t tileY = 0; tileY < tiles.y; ++tileY) {
+        for (ptrdiff_t tileX = 0; tileX < tiles.x; ++tileX) {
+            const float tileHeat = heat[(tileY * tiles.x) + tileX];
+            if (tileHeat <= 0.0f) {
+                continue;
+            }
+            // blend the hottest tile 60% towards red
+            const float alpha = 0.6f * (tileHeat / maximumHeat);
+            const ptrdiff_t endY = std::min((tileY + 1) * ActivityTileSize, worldSize.y);
+            const ptrdiff_t endX = std::min((tileX + 1) * ActivityTileSize, worldSize.x);
+            for (ptrdiff_t y = (tileY * ActivityTileSize); y < endY; ++y) {
+                for (ptrdiff_t x = (tileX * ActivityTileSize); x < endX; ++x) {
+                    sf::Uint8* const pixel = pixels + (((y * worldSize.x) + x) * 4);
+                    pixel[0] = static_cast<sf::Uint8>((pixel[0] * (1.0f - alpha)) + (255.0f * alpha));
+                    pixel[1] = static_cast<sf::Uint8>(pixel[1] * (1.0f - alpha));
+                    pixel[2] = static_cast<sf::Uint8>(pixel[2] * (1.0f - alpha));
+                }
+            }
+        }
     }
 }
 
-void clearWorld(World& world)
+void updateHeatMap(std::vector<float>& heat, const ActivityMap& frameActivity)
 {
-    std::fill(world.Cells.begin(), world.Cells.end(), Cell::Air);
+    assert(heat.size() == frameActivity.changes.size());
+    for (size_t i = 0; i < heat.size(); ++i) {
+        heat[i] = (heat[i] * HeatMapDecay) + static_cast<float>(frameActivity.changes[i]);
+    }
 }
 
-void saveWorldToFile(const World& world, const std::string& fileName)
+std::unique_ptr<SimulationEngine> createEngineFromSettings(const SimulationSettings& settings)
 {
-    std::ofstream file(fileName, std::ofstream::binary);
-    file.write(reinterpret_cast<const char*>(world.Cells.data()), sizeof(Cell) * world.Cells.size());
+    std::unique_ptr<SimulationEngine> engine = getEngines()[settings.engineIndex].create();
+    if (settings.isVerificationEnabled) {
+        return std::make_unique<VerifyingEngine>(std::move(engine));
+    }
+    return engine;
 }
 
-void loadWorldFromFile(World& world, const std::string& fileName)
+void clearWorld(World& world)
 {
-    std::ifstream file(fileName, std::ifstream::binary);
-    file.read(reinterpret_cast<char*>(world.Cells.data()), sizeof(Cell) * world.Cells.size());
+    std::fill(world.Cells.begin(), world.Cells.end(), Cell::Air);
 }
 
 int main()
@@ -83,13 +98,26 @@ int main()
     bool isMouseLeftDown = false;
     sf::Vector2u mousePosition;
 
-    sf::Clock worldStepClock;
-    sf::Time nextWorldStep = worldStepClock.getElapsedTime();
+    const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    const auto sinceStart = [startTime]() {
+        return std::chrono::duration_cast<StepScheduler::Duration>(std::chrono::steady_clock::now() - startTime);
+    };
+    StepScheduler scheduler(sinceStart());
 
     SimulationSettings settings;
     ProfilingInfo profiling;
+    SimulationSettings engineSettings = settings;
+    std::unique_ptr<SimulationEngine> engine = createEngineFromSettings(settings);
+    std::optional<ResumableStep> slicedStep;
+    StepScheduler::Duration slicedStepCost { 0 };
+
+    // changes during the current frame and since the start
+    ActivityMap frameActivity(worldSize);
+    ActivityMap totalActivity(worldSize);
+    std::vector<float> heat(frameActivity.changes.size(), 0.0f);
 
     bool isDemoVisible = false;
+    bool isFramerateLimited = true;
 
     sf::Clock deltaClock;
     while (window.isOpen()) {
@@ -128,40 +156,106 @@ int main()
         if (isMouseLeftDown) {
             const Point mouse = Point(mousePosition.x, mousePosition.y);
             setRectangle(world, mouse, worldSize, settings);
+            engine->regionChanged(world, getRectangleRegion(mouse, worldSize, settings));
+            if (slicedStep) {
+                slicedStep->setRectangle(mouse, settings);
+            }
         }
 
-        const sf::Time startedStepping = worldStepClock.getElapsedTime();
-        const sf::Time stopStepping = (startedStepping + sf::milliseconds(15));
-        for (;;) {
-            const sf::Time elapsed = worldStepClock.getElapsedTime();
-            if (elapsed >= stopStepping) {
-                break;
-            }
-            if (elapsed < nextWorldStep) {
-                break;
-            }
+        if ((settings.engineIndex != engineSettings.engineIndex) || (settings.isVerificationEnabled != engineSettings.isVerificationEnabled)) {
+            engineSettings = settings;
+            engine = createEngineFromSettings(settings);
+            profiling.divergence = std::nullopt;
+        }
+
+        if (settings.isMaxThroughput == isFramerateLimited) {
+            isFramerateLimited = !settings.isMaxThroughput;
+            window.setFramerateLimit(isFramerateLimited ? 60 : 0);
+        }
+
+        if (!settings.isTimeSliced) {
+            // the world still has its state from before the step, so an unfinished step can simply be dropped
+            slicedStep.reset();
+        }
 
-            const std::chrono::time_point start = std::chrono::high_resolution_clock::now();
-            if (!settings.isPaused) {
-                auto [cellsChanged, newWorld] = simulateStep(world);
-                profiling.cellsChanged = cellsChanged;
-                world = std::move(newWorld);
+        if (settings.isPaused) {
+            scheduler.reset(sinceStart());
+        } else if (settings.isTimeSliced) {
+            const StepScheduler::Duration startedStepping = sinceStart();
+            const StepScheduler::Duration stopStepping = (startedStepping + std::chrono::milliseconds(settings.frameBudgetInMilliseconds));
+            size_t plannedSteps = scheduler.beginFrame(startedStepping, settings);
+            // a started step is always continued, new ones are only started when the scheduler plans them
+            do {
+                if (!slicedStep) {
+                    if (plannedSteps == 0) {
+                        break;
+                    }
+                    --plannedSteps;
+                    slicedStep.emplace(world);
+                    slicedStepCost = StepScheduler::Duration(0);
+                }
+
+                const std::chrono::time_point start = std::chrono::high_resolution_clock::now();
+                const bool isComplete = slicedStep->advance(RowsPerSlice);
+                slicedStepCost += std::chrono::duration_cast<StepScheduler::Duration>(std::chrono::high_resolution_clock::now() - start);
+                if (isComplete) {
+                    auto [cellsChanged, newWorld] = slicedStep->finish(&frameActivity);
+                    profiling.cellsChanged = cellsChanged;
+                    world = std::move(newWorld);
+                    engine->worldReplaced(world);
+                    slicedStep.reset();
+                    profiling.simulationTime = std::chrono::duration_cast<std::chrono::milliseconds>(slicedStepCost);
+                    scheduler.recordStep(slicedStepCost);
+                }
+            } while (sinceStart() < stopStepping);
+            scheduler.endFrame(sinceStart(), settings, slicedStep.has_value());
+        } else {
+            const StepScheduler::Duration startedStepping = sinceStart();
+            const StepScheduler::Duration stopStepping = (startedStepping + std::chrono::milliseconds(settings.frameBudgetInMilliseconds));
+            const size_t plannedSteps = scheduler.beginFrame(startedStepping, settings);
+            for (size_t i = 0; i < plannedSteps; ++i) {
+                // the prediction may be wrong, so the budget is checked as well
+                if ((i > 0) && (sinceStart() >= stopStepping)) {
+                    break;
+                }
+
+                const std::chrono::time_point start = std::chrono::high_resolution_clock::now();
+                profiling.cellsChanged = engine->stepInPlace(world, &frameActivity);
+                const std::chrono::time_point stop = std::chrono::high_resolution_clock::now();
+                profiling.simulationTime = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
+                scheduler.recordStep(std::chrono::duration_cast<StepScheduler::Duration>(stop - start));
             }
-            const std::chrono::time_point stop = std::chrono::high_resolution_clock::now();
-            profiling.simulationTime = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
+            scheduler.endFrame(sinceStart(), settings, false);
+        }
+        profiling.scheduler = scheduler.getStatistics();
+        profiling.stepProgress = slicedStep ? std::optional<float>(slicedStep->getProgress()) : std::nullopt;
+        profiling.engineStatistics = engine->getStatistics();
+        if (const VerifyingEngine* const verifyingEngine = dynamic_cast<const VerifyingEngine*>(engine.get())) {
+            profiling.divergence = verifyingEngine->getFirstDivergence();
+        }
+        profiling.nonEmptyCells = world.Cells.size() - world.getEmptyCells();
 
-            profiling.nonEmptyCells = world.Cells.size() - world.getEmptyCells();
-            nextWorldStep += sf::milliseconds(settings.timeBetweenStepsInMilliseconds);
+        updateHeatMap(heat, frameActivity);
+        for (size_t i = 0; i < frameActivity.changes.size(); ++i) {
+            totalActivity.changes[i] += frameActivity.changes[i];
         }
+        frameActivity.clear();
 
         ImGui::SFML::Update(window, deltaClock.restart());
 
         const std::chrono::time_point start = std::chrono::high_resolution_clock::now();
-        renderUI(world, settings, profiling, isDemoVisible);
+        if (renderUI(world, settings, profiling, totalActivity, isDemoVisible)) {
+            engine->worldReplaced(world);
+            // the step started from the old world
+            slicedStep.reset();
+        }
 
         window.clear();
 
         renderWorld(worldImage, world.Cells.front(), worldSize);
+        if (settings.isHeatMapVisible) {
+            renderHeatMap(worldImage, heat, frameActivity.tiles, worldSize);
+        }
 
         sf::Texture worldTexture;
         if (!worldTexture.loadFromImage(worldImage)) {
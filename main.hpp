@@ -1,17 +1,31 @@
 #pragma once
 
+#include "engine.hpp"
+#include "resumable_step.hpp"
+#include "scheduler.hpp"
 #include "simulation.hpp"
 #include <chrono>
+#include <optional>
 #include <string>
 #include <vector>
 
 struct ProfilingInfo {
     size_t cellsChanged;
     size_t nonEmptyCells;
+    EngineStatistics engineStatistics;
+    std::optional<Divergence> divergence;
+    SchedulerStatistics scheduler;
+    // only while a step is spread across frames
+    std::optional<float> stepProgress;
     std::chrono::milliseconds simulationTime;
     std::chrono::milliseconds renderTime;
 };
 
+std::unique_ptr<SimulationEngine> createEngineFromSettings(const SimulationSettings& settings);
+// how much of the heat of a tile is left after one frame
+constexpr float HeatMapDecay = 0.95f;
+// with SimulationSettings::isTimeSliced the frame budget is checked after every slice of this many rows
+constexpr ptrdiff_t RowsPerSlice = 16;
+
+void updateHeatMap(std::vector<float>& heat, const ActivityMap& frameActivity);
 void clearWorld(World& world);
-void saveWorldToFile(const World& world, const std::string& fileName);
-void loadWorldFromFile(World& world, const std::string& fileName);
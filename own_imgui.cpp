@@ -1,25 +1,34 @@
 #include "own_imgui.hpp"
 #include "imgui-SFML.h"
 #include "imgui.h"
+#include "kernels.hpp"
 #include <array>
+#include <sstream>
 
-constexpr std::array<char*, 5> materialNames { "Air", "Snow", "Wall", "Sand", "Eraser" };
+constexpr std::array<const char*, 5> materialNames { "Air", "Snow", "Wall", "Sand", "Eraser" };
+constexpr std::array<const char*, 3> backlogPolicyNames { "Catch up", "Drop ticks", "Lower tick rate" };
 
-void menuBar(World& world, bool& isDemoVisible)
+bool menuBar(World& world, SimulationSettings& settings, const ActivityMap& activity, bool& isDemoVisible)
 {
     if (!ImGui::BeginMainMenuBar()) {
-        return;
+        return false;
     }
 
+    bool isWorldReplaced = false;
     if (ImGui::BeginMenu("File")) {
         if (ImGui::MenuItem("New", "Ctrl+N")) {
             clearWorld(world);
+            isWorldReplaced = true;
         }
         if (ImGui::MenuItem("Save", "Ctrl+S")) {
             saveWorldToFile(world, "world.dat");
         }
         if (ImGui::MenuItem("Load", "Ctrl+O")) {
             loadWorldFromFile(world, "world.dat");
+            isWorldReplaced = true;
+        }
+        if (ImGui::MenuItem("Export activity")) {
+            saveActivityToFile(activity, "activity.csv");
         }
         ImGui::EndMenu();
     }
@@ -27,9 +36,13 @@ void menuBar(World& world, bool& isDemoVisible)
         if (ImGui::MenuItem("ImGui demo")) {
             isDemoVisible = !isDemoVisible;
         }
+        if (ImGui::MenuItem("Activity heat map", nullptr, settings.isHeatMapVisible)) {
+            settings.isHeatMapVisible = !settings.isHeatMapVisible;
+        }
         ImGui::EndMenu();
     }
     ImGui::EndMainMenuBar();
+    return isWorldReplaced;
 }
 
 void addBrushTreeNode(SimulationSettings& settings)
@@ -51,6 +64,28 @@ void addSimulationSettingsNode(SimulationSettings& settings)
 {
     ImGui::SliderInt("Time between steps (ms)", &settings.timeBetweenStepsInMilliseconds, 0, 1000);
     ImGui::Checkbox("Pause", &settings.isPaused);
+    ImGui::SliderInt("Frame budget (ms)", &settings.frameBudgetInMilliseconds, 1, 100);
+    ImGui::Checkbox("Max throughput", &settings.isMaxThroughput);
+    ImGui::Checkbox("Split steps across frames", &settings.isTimeSliced);
+    if (ImGui::BeginCombo("When behind", backlogPolicyNames[static_cast<size_t>(settings.backlogPolicy)])) {
+        for (size_t i = 0; i < backlogPolicyNames.size(); i++) {
+            if (ImGui::Selectable(backlogPolicyNames[i], (settings.backlogPolicy == static_cast<BacklogPolicy>(i)))) {
+                settings.backlogPolicy = static_cast<BacklogPolicy>(i);
+            }
+        }
+        ImGui::EndCombo();
+    }
+
+    const std::vector<EngineDescription>& engines = getEngines();
+    if (ImGui::BeginCombo("Engine", engines[settings.engineIndex].name.c_str())) {
+        for (size_t i = 0; i < engines.size(); i++) {
+            if (ImGui::Selectable(engines[i].name.c_str(), (settings.engineIndex == static_cast<int>(i)))) {
+                settings.engineIndex = static_cast<int>(i);
+            }
+        }
+        ImGui::EndCombo();
+    }
+    ImGui::Checkbox("Verify against reference", &settings.isVerificationEnabled);
 }
 
 void addProfilingNode(const ProfilingInfo& profilingInfo)
@@ -58,16 +93,38 @@ void addProfilingNode(const ProfilingInfo& profilingInfo)
     if (!ImGui::TreeNode("Profiling")) {
         return;
     }
-    ImGui::Text(("Cells filled: " + std::to_string(profilingInfo.nonEmptyCells)).c_str());
-    ImGui::Text(("Cells changed: " + std::to_string(profilingInfo.cellsChanged)).c_str());
-    ImGui::Text(("Simulation time: " + std::to_string(profilingInfo.simulationTime.count()) + " ms").c_str());
-    ImGui::Text(("Render time: " + std::to_string(profilingInfo.renderTime.count()) + " ms").c_str());
+    ImGui::TextUnformatted(("Cells filled: " + std::to_string(profilingInfo.nonEmptyCells)).c_str());
+    ImGui::TextUnformatted(("Cells changed: " + std::to_string(profilingInfo.cellsChanged)).c_str());
+    for (const auto& [name, value] : profilingInfo.engineStatistics) {
+        ImGui::TextUnformatted((name + ": " + std::to_string(value)).c_str());
+    }
+    if (profilingInfo.divergence) {
+        std::ostringstream divergence;
+        divergence << "Diverged from reference: " << *profilingInfo.divergence;
+        ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "%s", divergence.str().c_str());
+    }
+    ImGui::TextUnformatted((std::string("Kernels: ") + getSelectedKernelVariant().name).c_str());
+    ImGui::TextUnformatted(("Simulation time: " + std::to_string(profilingInfo.simulationTime.count()) + " ms").c_str());
+    ImGui::TextUnformatted(("Render time: " + std::to_string(profilingInfo.renderTime.count()) + " ms").c_str());
+
+    const SchedulerStatistics& scheduler = profilingInfo.scheduler;
+    const auto toMicroseconds = [](const std::chrono::nanoseconds duration) {
+        return std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+    };
+    ImGui::TextUnformatted(("Steps last frame: " + std::to_string(scheduler.stepsLastFrame)).c_str());
+    ImGui::TextUnformatted(("Predicted step time: " + toMicroseconds(scheduler.predictedStepCost) + " us").c_str());
+    ImGui::TextUnformatted(("Time between steps: " + toMicroseconds(scheduler.tickInterval) + " us").c_str());
+    ImGui::TextUnformatted(("Steps behind: " + std::to_string(scheduler.backlog)).c_str());
+    ImGui::TextUnformatted(("Steps dropped: " + std::to_string(scheduler.droppedTicks)).c_str());
+    if (profilingInfo.stepProgress) {
+        ImGui::ProgressBar(*profilingInfo.stepProgress, ImVec2(-1.0f, 0.0f), "Current step");
+    }
     ImGui::TreePop();
 }
 
-void renderUI(World& world, SimulationSettings& settings, const ProfilingInfo& profilingInfo, bool& isDemoVisible)
+bool renderUI(World& world, SimulationSettings& settings, const ProfilingInfo& profilingInfo, const ActivityMap& activity, bool& isDemoVisible)
 {
-    menuBar(world, isDemoVisible);
+    const bool isWorldReplaced = menuBar(world, settings, activity, isDemoVisible);
 
     ImGui::Begin("Toolbox");
     addBrushTreeNode(settings);
@@ -78,4 +135,5 @@ void renderUI(World& world, SimulationSettings& settings, const ProfilingInfo& p
     if (isDemoVisible) {
         ImGui::ShowDemoWindow(&isDemoVisible);
     }
+    return isWorldReplaced;
 }
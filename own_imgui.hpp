@@ -1,3 +1,4 @@
 #include "main.hpp"
 
-void renderUI(World& world, SimulationSettings& settings, const ProfilingInfo& profilingInfo, bool& isDemoVisible);
+// Returns true if the world was replaced from the menu, e.g. by File > New.
+bool renderUI(World& world, SimulationSettings& settings, const ProfilingInfo& profilingInfo, const ActivityMap& activity, bool& isDemoVisible);
@@ -0,0 +1,58 @@
+#include "resumable_step.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+ResumableStep::ResumableStep(const World& world)
+    : source(world)
+    , height((world.Width == 0) ? 0 : static_cast<ptrdiff_t>(world.Cells.size()) / world.Width)
+    , nextBottom(height)
+    , result(Point(world.Width, height), Cell::Air)
+    , stepActivity(Point(world.Width, height))
+{
+}
+
+bool ResumableStep::advance(const ptrdiff_t maximumRows)
+{
+    if ((nextBottom > 0) && (maximumRows > 0)) {
+        const ptrdiff_t top = std::max<ptrdiff_t>(0, nextBottom - maximumRows);
+        cellsChanged += simulateRegion(source, result, Region { 0, top, static_cast<ptrdiff_t>(source.Width), nextBottom }, &stepActivity);
+        nextBottom = top;
+    }
+    return isComplete();
+}
+
+bool ResumableStep::isComplete() const
+{
+    return nextBottom == 0;
+}
+
+float ResumableStep::getProgress() const
+{
+    return (height == 0) ? 1.0f : (static_cast<float>(height - nextBottom) / static_cast<float>(height));
+}
+
+void ResumableStep::setRectangle(const Point& center, const SimulationSettings& settings)
+{
+    brushStrokes.emplace_back(center, settings);
+}
+
+std::pair<CellsChanged, World> ResumableStep::finish(ActivityMap* activity)
+{
+    if (!isComplete()) {
+        throw std::logic_error("The step isn't complete yet");
+    }
+    // setRectangle doesn't depend on the cells it paints over, so it paints exactly the same cells as on the world
+    const Point worldSize(static_cast<ptrdiff_t>(result.Width), height);
+    for (const auto& [center, settings] : brushStrokes) {
+        ::setRectangle(result, center, worldSize, settings);
+    }
+    if (activity) {
+        if (activity->changes.size() != stepActivity.changes.size()) {
+            throw std::invalid_argument("The activity map doesn't match the size of the world");
+        }
+        for (size_t i = 0; i < activity->changes.size(); ++i) {
+            activity->changes[i] += stepActivity.changes[i];
+        }
+    }
+    return { cellsChanged, std::move(result) };
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "simulation.hpp"
+#include <vector>
+
+// One simulation step that can be spread over several calls, e.g. over several frames for worlds that are too large to
+// be simulated within one frame. The rows are simulated from the bottom to the top with simulateRegion, so the result is
+// exactly the same as the one of simulateStep. The result is only available once all rows are simulated.
+class ResumableStep {
+public:
+    explicit ResumableStep(const World& world);
+
+    // Simulates up to `maximumRows` more rows and returns whether the step is complete.
+    bool advance(ptrdiff_t maximumRows);
+    bool isComplete() const;
+    // between 0 and 1
+    float getProgress() const;
+
+    // The brush was used on the world while the step was running. finish() paints the same cells of the result.
+    void setRectangle(const Point& center, const SimulationSettings& settings);
+
+    // Returns the result of the complete step with all brush strokes painted over it.
+    // activity may be nullptr, otherwise the changed cells of the step are added to it
+    std::pair<CellsChanged, World> finish(ActivityMap* activity);
+
+private:
+    World source;
+    ptrdiff_t height;
+    // the rows from here to the bottom are simulated already
+    ptrdiff_t nextBottom;
+    World result;
+    CellsChanged cellsChanged = 0;
+    // only handed out by finish(), a step that is dropped hasn't changed anything
+    ActivityMap stepActivity;
+    // replayed in order, later strokes paint over earlier ones
+    std::vector<std::pair<Point, SimulationSettings>> brushStrokes;
+};
@@ -0,0 +1,143 @@
+#include "scheduler.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// weight of the newest measurement in the moving averages
+constexpr double CostSmoothing = 0.2;
+
+// CatchUp never keeps more than this much simulated time in the backlog
+constexpr std::chrono::milliseconds MaximumCatchUp(250);
+
+// LowerTickRate slows the ticks down by this factor when it falls behind and speeds them up again when there is room
+constexpr double TickSlowDown = 1.25;
+constexpr double TickSpeedUp = 0.95;
+constexpr std::chrono::milliseconds SlowestTickInterval(1000);
+
+StepScheduler::Duration getRequestedTickInterval(const SimulationSettings& settings)
+{
+    return std::chrono::milliseconds(settings.timeBetweenStepsInMilliseconds);
+}
+}
+
+StepScheduler::StepScheduler(Duration now)
+    : nextTick(now)
+{
+}
+
+size_t StepScheduler::beginFrame(Duration now, const SimulationSettings& settings)
+{
+    stepsThisFrame = 0;
+    frameStart = now;
+
+    const Duration requested = getRequestedTickInterval(settings);
+    if ((settings.backlogPolicy != BacklogPolicy::LowerTickRate) || settings.isTimeSliced || (tickInterval < requested)) {
+        tickInterval = requested;
+    }
+
+    const Duration budget = std::chrono::milliseconds(settings.frameBudgetInMilliseconds);
+    const Duration predictedCost = getPredictedStepCost();
+    // the first step has to be measured before anything can be predicted
+    size_t affordable = 1;
+    if (hasMeasuredSteps && (predictedCost.count() > 0)) {
+        affordable = std::max<size_t>(1, static_cast<size_t>(budget / predictedCost));
+    }
+
+    if (settings.isMaxThroughput || (tickInterval.count() == 0)) {
+        return affordable;
+    }
+    if (now < nextTick) {
+        return 0;
+    }
+    const size_t due = static_cast<size_t>((now - nextTick) / tickInterval) + 1;
+    return std::min(due, affordable);
+}
+
+void StepScheduler::recordStep(Duration cost)
+{
+    const double measured = static_cast<double>(cost.count());
+    if (hasMeasuredSteps) {
+        averageDeviation += CostSmoothing * (std::abs(measured - averageCost) - averageDeviation);
+        averageCost += CostSmoothing * (measured - averageCost);
+    } else {
+        averageCost = measured;
+        averageDeviation = 0.0;
+        hasMeasuredSteps = true;
+    }
+    nextTick += tickInterval;
+    ++stepsThisFrame;
+}
+
+void StepScheduler::endFrame(Duration now, const SimulationSettings& settings, const bool isStepInProgress)
+{
+    stepsLastFrame = stepsThisFrame;
+
+    if (settings.isMaxThroughput || (tickInterval.count() == 0)) {
+        reset(now);
+        return;
+    }
+    if (isStepInProgress) {
+        return;
+    }
+
+    if (frameStart < nextTick) {
+        backlog = 0;
+        const Duration requested = getRequestedTickInterval(settings);
+        const Duration budget = std::chrono::milliseconds(settings.frameBudgetInMilliseconds);
+        const bool hadRoomLeft = ((getPredictedStepCost() * static_cast<Duration::rep>(stepsThisFrame + 1)) < (budget / 2));
+        if ((settings.backlogPolicy == BacklogPolicy::LowerTickRate) && (tickInterval > requested) && hadRoomLeft) {
+            tickInterval = std::max(requested, std::chrono::duration_cast<Duration>(tickInterval * TickSpeedUp));
+        }
+        return;
+    }
+
+    backlog = static_cast<size_t>((frameStart - nextTick) / tickInterval) + 1;
+    switch (settings.backlogPolicy) {
+    case BacklogPolicy::CatchUp: {
+        const size_t maximumBacklog = std::max<size_t>(1, static_cast<size_t>(Duration(MaximumCatchUp) / tickInterval));
+        if (backlog > maximumBacklog) {
+            const size_t dropped = (backlog - maximumBacklog);
+            nextTick += tickInterval * static_cast<Duration::rep>(dropped);
+            droppedTicks += dropped;
+            backlog = maximumBacklog;
+        }
+        break;
+    }
+
+    case BacklogPolicy::DropTicks:
+        nextTick += tickInterval * static_cast<Duration::rep>(backlog);
+        droppedTicks += backlog;
+        backlog = 0;
+        break;
+
+    case BacklogPolicy::LowerTickRate:
+        nextTick += tickInterval * static_cast<Duration::rep>(backlog);
+        droppedTicks += backlog;
+        backlog = 0;
+        // Steps that are spread over several frames are always behind, a slower tick rate would only leave frames idle.
+        if (settings.isTimeSliced) {
+            break;
+        }
+        // at least one nanosecond, so that tiny intervals can grow as well
+        tickInterval = std::max<Duration>(std::chrono::duration_cast<Duration>(tickInterval * TickSlowDown), tickInterval + Duration(1));
+        tickInterval = std::min<Duration>(tickInterval, SlowestTickInterval);
+        break;
+    }
+}
+
+void StepScheduler::reset(Duration now)
+{
+    nextTick = now;
+    backlog = 0;
+}
+
+StepScheduler::Duration StepScheduler::getPredictedStepCost() const
+{
+    // pessimistic, so that a noisy step doesn't blow the frame budget
+    return Duration(static_cast<Duration::rep>(averageCost + (2.0 * averageDeviation)));
+}
+
+SchedulerStatistics StepScheduler::getStatistics() const
+{
+    return { stepsLastFrame, backlog, droppedTicks, getPredictedStepCost(), tickInterval };
+}
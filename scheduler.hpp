@@ -0,0 +1,51 @@
+#pragma once
+#include "simulation.hpp"
+#include <chrono>
+
+struct SchedulerStatistics {
+    size_t stepsLastFrame;
+    // ticks that are due but not simulated yet
+    size_t backlog;
+    size_t droppedTicks;
+    std::chrono::nanoseconds predictedStepCost;
+    // differs from SimulationSettings::timeBetweenStepsInMilliseconds with BacklogPolicy::LowerTickRate, unless the steps
+    // are time sliced
+    std::chrono::nanoseconds tickInterval;
+};
+
+// Decides how many steps fit into a frame. It measures the cost of every step and predicts how many more fit into the
+// frame budget. Ticks that can't be simulated in time are handled according to SimulationSettings::backlogPolicy, so
+// the backlog stays bounded even if a single step takes longer than a frame.
+// All times are measured from the same arbitrary point, e.g. the start of the program.
+class StepScheduler {
+public:
+    using Duration = std::chrono::nanoseconds;
+
+    explicit StepScheduler(Duration now);
+
+    // Returns how many steps should be simulated in this frame.
+    size_t beginFrame(Duration now, const SimulationSettings& settings);
+    void recordStep(Duration cost);
+    // isStepInProgress is true if a step that is spread over several frames isn't complete yet. The ticks that came due
+    // in the meantime are only handled once it is.
+    void endFrame(Duration now, const SimulationSettings& settings, bool isStepInProgress);
+
+    // Forgets all due ticks, e.g. while the simulation is paused.
+    void reset(Duration now);
+
+    Duration getPredictedStepCost() const;
+    SchedulerStatistics getStatistics() const;
+
+private:
+    Duration nextTick;
+    // the backlog only counts ticks that were due at the start of the frame, not the ones that came due while stepping
+    Duration frameStart { 0 };
+    Duration tickInterval { 0 };
+    double averageCost = 0.0;
+    double averageDeviation = 0.0;
+    bool hasMeasuredSteps = false;
+    size_t stepsThisFrame = 0;
+    size_t stepsLastFrame = 0;
+    size_t backlog = 0;
+    size_t droppedTicks = 0;
+};
@@ -1,8 +1,9 @@
 #include "simulation.hpp"
-#include <array>
+#include "kernels.hpp"
+#include <algorithm>
 #include <cassert>
+#include <fstream>
 
-namespace {
 char CellToChar(const Cell value)
 {
     switch (value) {
@@ -19,7 +20,6 @@ char CellToChar(const Cell value)
     }
     VENT_UNREACHABLE();
 }
-}
 
 World::World(const Point& size, Cell defaultMaterial)
     : Cells(size.x * size.y, defaultMaterial)
@@ -39,6 +39,17 @@ size_t World::getEmptyCells() const
     return std::count(Cells.begin(), Cells.end(), Cell::Air);
 }
 
+ActivityMap::ActivityMap(const Point& worldSize)
+    : tiles((worldSize.x + ActivityTileSize - 1) / ActivityTileSize, (worldSize.y + ActivityTileSize - 1) / ActivityTileSize)
+    , changes(tiles.x * tiles.y, 0)
+{
+}
+
+void ActivityMap::clear()
+{
+    std::fill(changes.begin(), changes.end(), 0);
+}
+
 bool operator==(const World& left, const World& right) noexcept
 {
     return (left.Cells == right.Cells) && (left.Width == right.Width);
@@ -55,6 +66,20 @@ std::ostream& operator<<(std::ostream& out, const World& value)
     return out;
 }
 
+std::ostream& operator<<(std::ostream& out, const ActivityMap& value)
+{
+    for (ptrdiff_t y = 0; y < value.tiles.y; y++) {
+        for (ptrdiff_t x = 0; x < value.tiles.x; x++) {
+            if (x != 0) {
+                out << ',';
+            }
+            out << value.changes[(y * value.tiles.x) + x];
+        }
+        out << '\n';
+    }
+    return out;
+}
+
 std::optional<size_t> getIndexFromCoordinates(const Point& coordinates, const Point worldSize)
 {
     if ((coordinates.x < 0) || (coordinates.x >= worldSize.x)) {
@@ -66,126 +91,31 @@ std::optional<size_t> getIndexFromCoordinates(const Point& coordinates, const Po
     return (coordinates.y * worldSize.x) + coordinates.x;
 }
 
-namespace {
-bool canFallInto(const Cell into)
+CellsChanged simulateRegion(const World& world, World& into, const Region& region, ActivityMap* activity)
 {
-    switch (into) {
-    case Cell::Air:
-    case Cell::Eraser:
-        return true;
-    case Cell::Snow:
-    case Cell::Sand:
-    case Cell::Wall:
-        return false;
-    }
-    VENT_UNREACHABLE();
+    assert(world.Width == into.Width);
+    assert(world.Cells.size() == into.Cells.size());
+    std::uint32_t* const tileChanges = (activity != nullptr) ? activity->changes.data() : nullptr;
+    const ptrdiff_t tilesPerRow = (activity != nullptr) ? activity->tiles.x : 0;
+    assert((activity == nullptr) || (tilesPerRow == ((static_cast<ptrdiff_t>(world.Width) + ActivityTileSize - 1) / ActivityTileSize)));
+    return getSelectedKernelVariant().kernels.simulateRegion(world.Cells.data(), into.Cells.data(), world.Width, world.Cells.size(), region, tileChanges, tilesPerRow);
 }
 
-[[nodiscard]] Cell fall(const Cell top, const Cell bottom)
+std::pair<CellsChanged, World> simulateStep(const World& world)
 {
-    assert(canFallInto(bottom));
-    switch (bottom) {
-    case Cell::Air:
-        return top;
-
-    case Cell::Eraser:
-        return bottom;
-
-    case Cell::Snow:
-    case Cell::Sand:
-    case Cell::Wall:
-        VENT_UNREACHABLE();
-    }
-    VENT_UNREACHABLE();
-}
+    return simulateStep(world, nullptr);
 }
 
-std::pair<CellsChanged, World> simulateStep(const World& world)
+std::pair<CellsChanged, World> simulateStep(const World& world, ActivityMap* activity)
 {
     const ptrdiff_t worldWidth = world.Width;
-    size_t cellsChanged = 0;
     if (worldWidth == 0) {
         return { 0, world };
     }
     const ptrdiff_t worldHeight = world.Cells.size() / world.Width;
     World result(Point { worldWidth, worldHeight }, Cell::Air);
-
-    // std::vector::operator[] is very expensive on Debug under MSVC, so we use this pointer instead
-    Cell* const newWorld = result.Cells.data();
-
-    size_t cellIndex = result.Cells.size();
-    for (ptrdiff_t y = (worldHeight - 1); y >= 0; --y) {
-        for (ptrdiff_t x = (worldWidth - 1); x >= 0; --x) {
-            --cellIndex;
-            // std::vector::operator[] is very expensive on Debug under MSVC, so we use this pointer instead
-            const Cell& cell = world.Cells.data()[cellIndex];
-            switch (cell) {
-            case Cell::Air:
-                continue;
-
-            case Cell::Snow: {
-                const size_t belowIndex = (cellIndex + worldWidth);
-                if ((belowIndex < result.Cells.size()) && canFallInto(newWorld[belowIndex])) {
-                    newWorld[cellIndex] = Cell::Air;
-                    newWorld[belowIndex] = fall(cell, newWorld[belowIndex]);
-                    cellsChanged++;
-                } else {
-                    newWorld[cellIndex] = cell;
-                }
-                break;
-            }
-
-            case Cell::Sand: {
-                const size_t belowIndex = (cellIndex + worldWidth);
-                if (belowIndex < result.Cells.size()) {
-                    if (canFallInto(newWorld[belowIndex])) {
-                        newWorld[cellIndex] = Cell::Air;
-                        newWorld[belowIndex] = fall(cell, newWorld[belowIndex]);
-                        cellsChanged++;
-                        break;
-                    }
-
-                    const std::array<bool, 2> isWithinBounds = {
-                        (x < (worldWidth - 1)),
-                        (x > 0)
-                    };
-
-                    static constexpr std::array<ptrdiff_t, 2> horizontalOffsets = {
-                        1,
-                        -1
-                    };
-
-                    bool fellToTheSide = false;
-                    for (size_t i = 0; i < horizontalOffsets.size(); ++i) {
-                        if (!isWithinBounds[i]) {
-                            continue;
-                        }
-                        const size_t belowLeftRightIndex = (belowIndex + horizontalOffsets[i]);
-                        if (canFallInto(newWorld[belowLeftRightIndex])) {
-                            newWorld[cellIndex] = Cell::Air;
-                            newWorld[belowLeftRightIndex] = fall(cell, newWorld[belowLeftRightIndex]);
-                            fellToTheSide = true;
-                            cellsChanged++;
-                            break;
-                        }
-                    }
-                    if (fellToTheSide) {
-                        break;
-                    }
-                }
-
-                newWorld[cellIndex] = cell;
-                break;
-            }
-
-            case Cell::Wall:
-            case Cell::Eraser:
-                newWorld[cellIndex] = cell;
-                break;
-            }
-        }
-    }
-    return { cellsChanged, result };
+    const CellsChanged cellsChanged = simulateRegion(world, result, Region { 0, 0, worldWidth, worldHeight }, activity);
+    return { cellsChanged, std::move(result) };
 }
 
 void setRectangle(World& world, const Point& center, const Point& worldSize, const SimulationSettings& settings)
@@ -208,3 +138,31 @@ void setRectangle(World& world, const Point& center, const Point& worldSize, con
         }
     }
 }
+
+Region getRectangleRegion(const Point& center, const Point& worldSize, const SimulationSettings& settings)
+{
+    return Region {
+        std::clamp<ptrdiff_t>(center.x - settings.brushSize, 0, worldSize.x),
+        std::clamp<ptrdiff_t>(center.y - settings.brushSize, 0, worldSize.y),
+        std::clamp<ptrdiff_t>(center.x + settings.brushSize, 0, worldSize.x),
+        std::clamp<ptrdiff_t>(center.y + settings.brushSize, 0, worldSize.y),
+    };
+}
+
+void saveWorldToFile(const World& world, const std::string& fileName)
+{
+    std::ofstream file(fileName, std::ofstream::binary);
+    file.write(reinterpret_cast<const char*>(world.Cells.data()), sizeof(Cell) * world.Cells.size());
+}
+
+void loadWorldFromFile(World& world, const std::string& fileName)
+{
+    std::ifstream file(fileName, std::ifstream::binary);
+    file.read(reinterpret_cast<char*>(world.Cells.data()), sizeof(Cell) * world.Cells.size());
+}
+
+void saveActivityToFile(const ActivityMap& activity, const std::string& fileName)
+{
+    std::ofstream file(fileName);
+    file << activity;
+}
@@ -1,10 +1,17 @@
 #pragma once
 #include <SFML/System/Vector2.hpp>
+#include <cstddef>
+#include <cstdint>
 #include <optional>
 #include <ostream>
+#include <string>
 #include <vector>
 
+#if defined(_MSC_VER)
 #define VENT_UNREACHABLE() __assume(false)
+#else
+#define VENT_UNREACHABLE() __builtin_unreachable()
+#endif
 
 enum class Cell : char {
     Air,
@@ -27,17 +34,72 @@ struct World {
     size_t getEmptyCells() const;
 };
 
+// Half-open rectangle of cell coordinates: [left, right) x [top, bottom)
+struct Region {
+    ptrdiff_t left;
+    ptrdiff_t top;
+    ptrdiff_t right;
+    ptrdiff_t bottom;
+};
+
+// Edge length of the square tiles that activity is counted for
+constexpr ptrdiff_t ActivityTileSize = 16;
+
+// Number of changed cells per tile, counted where the cell was before it moved
+struct ActivityMap {
+    // number of tiles horizontally and vertically
+    Point tiles;
+    // row-major, one counter per tile
+    std::vector<std::uint32_t> changes;
+
+    explicit ActivityMap(const Point& worldSize);
+
+    void clear();
+};
+
+// What to do with ticks that couldn't be simulated in their frame
+enum class BacklogPolicy {
+    CatchUp,
+    DropTicks,
+    LowerTickRate
+};
+
 struct SimulationSettings {
     int timeBetweenStepsInMilliseconds = 3;
+    int frameBudgetInMilliseconds = 15;
+    BacklogPolicy backlogPolicy = BacklogPolicy::CatchUp;
+    // step as often as the frame budget allows, regardless of the time between steps and the frame rate limit
+    bool isMaxThroughput = false;
+    // spreads steps that take longer than the frame budget over several frames, always uses the reference simulation
+    bool isTimeSliced = false;
     bool isPaused = false;
     int brushSize = 20;
     Cell currentMaterial = Cell::Snow;
     float brushStrength = 1.0;
+    // index into getEngines()
+    int engineIndex = 0;
+    bool isVerificationEnabled = false;
+    bool isHeatMapVisible = false;
 };
 
+char CellToChar(Cell value);
 bool operator==(const World& left, const World& right) noexcept;
 std::ostream& operator<<(std::ostream& out, const World& value);
+// one line of comma separated counters per row of tiles
+std::ostream& operator<<(std::ostream& out, const ActivityMap& value);
 
 std::optional<size_t> getIndexFromCoordinates(const Point& coordinates, const Point worldSize);
 std::pair<CellsChanged, World> simulateStep(const World& world);
+// activity may be nullptr, otherwise the changed cells are added to it
+std::pair<CellsChanged, World> simulateStep(const World& world, ActivityMap* activity);
+
+// Runs the simulation for the cells of `region` only, writing into `into` in the same order as simulateStep.
+// The cells of `region` in `into` have to be Air and the rows below it have to be simulated already.
+CellsChanged simulateRegion(const World& world, World& into, const Region& region, ActivityMap* activity);
+void saveWorldToFile(const World& world, const std::string& fileName);
+void loadWorldFromFile(World& world, const std::string& fileName);
+void saveActivityToFile(const ActivityMap& activity, const std::string& fileName);
+
 void setRectangle(World& world, const Point& center, const Point& worldSize, const SimulationSettings& settings);
+// the cells that setRectangle may change, clipped to the world
+Region getRectangleRegion(const Point& center, const Point& worldSize, const SimulationSettings& settings);
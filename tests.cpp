@@ -1,6 +1,15 @@
 #define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this in one cpp file
 #include "catch.hpp"
+#include "active_particles.hpp"
+#include "engine.hpp"
+#include "ensemble.hpp"
+#include "kernels.hpp"
+#include "resumable_step.hpp"
+#include "scheduler.hpp"
 #include "simulation.hpp"
+#include "transition_cache.hpp"
+#include <algorithm>
+#include <random>
 
 TEST_CASE("filling a rectangle with size 1")
 {
@@ -285,3 +294,655 @@ TEST_CASE("getIndexFromCoordinates out of bounds")
     REQUIRE(!getIndexFromCoordinates(Point(0, -1), Point(1, 1)));
     REQUIRE(!getIndexFromCoordinates(Point(0, 1), Point(1, 1)));
 }
+
+namespace {
+World createWallGrid(const Point& size)
+{
+    World world(size, Cell::Snow);
+    for (ptrdiff_t y = 0; y < size.y; y += 8) {
+        for (ptrdiff_t x = 0; x < size.x; ++x) {
+            world.Cells[(y * size.x) + x] = Cell::Wall;
+        }
+    }
+    return world;
+}
+}
+
+TEST_CASE("cached step is the same as simulateStep")
+{
+    const unsigned seed = GENERATE(1u, 2u, 3u);
+    const Point size = GENERATE(Point(1, 1), Point(16, 16), Point(37, 50), Point(64, 64));
+    World world = createRandomWorld(size, seed);
+    TransitionCache cache(64);
+    for (int step = 0; step < 20; ++step) {
+        const std::pair<CellsChanged, World> expected = simulateStep(world);
+        const std::pair<CellsChanged, World> result = simulateStepCached(world, cache, nullptr);
+        REQUIRE(expected.first == result.first);
+        REQUIRE(expected.second == result.second);
+        world = expected.second;
+    }
+}
+
+TEST_CASE("cached step is the same as simulateStep with sparse sand")
+{
+    const unsigned seed = GENERATE(4u, 5u);
+    World world = createRandomWorld(Point(96, 80), seed);
+    for (size_t i = 0; i < world.Cells.size(); ++i) {
+        if ((world.Cells[i] == Cell::Sand) && ((i % 13) != 0)) {
+            world.Cells[i] = Cell::Air;
+        }
+    }
+    TransitionCache cache(256);
+    for (int step = 0; step < 40; ++step) {
+        const std::pair<CellsChanged, World> expected = simulateStep(world);
+        const std::pair<CellsChanged, World> result = simulateStepCached(world, cache, nullptr);
+        REQUIRE(expected.first == result.first);
+        REQUIRE(expected.second == result.second);
+        world = expected.second;
+    }
+    REQUIRE(cache.getHits() > 0);
+}
+
+TEST_CASE("cached step counts activity after the height of the world changed")
+{
+    TransitionCache cache(1024);
+    // every other row is Snow, so the chunks are the same for every even height, but aligned differently with the tiles
+    for (const ptrdiff_t height : { 32, 34, 32 }) {
+        World world(Point(32, height), Cell::Air);
+        for (ptrdiff_t y = 0; y < height; y += 2) {
+            std::fill(world.Cells.begin() + (y * 32), world.Cells.begin() + ((y + 1) * 32), Cell::Snow);
+        }
+        ActivityMap expected(Point(32, height));
+        ActivityMap actual(Point(32, height));
+        REQUIRE(simulateStepCached(world, cache, &actual) == simulateStep(world, &expected));
+        REQUIRE(actual.changes == expected.changes);
+    }
+}
+
+TEST_CASE("cached step reuses repeated chunks")
+{
+    World world = createWallGrid(Point(128, 128));
+    TransitionCache cache(64);
+    for (int step = 0; step < 10; ++step) {
+        const std::pair<CellsChanged, World> expected = simulateStep(world);
+        const std::pair<CellsChanged, World> result = simulateStepCached(world, cache, nullptr);
+        REQUIRE(expected.first == result.first);
+        REQUIRE(expected.second == result.second);
+        world = expected.second;
+    }
+    REQUIRE(cache.getHits() > cache.getMisses());
+}
+
+TEST_CASE("transition cache evicts the least recently used chunk")
+{
+    TransitionCache cache(2);
+    ChunkKey first;
+    first.fill(Cell::Air);
+    ChunkKey second = first;
+    second[0] = Cell::Snow;
+    ChunkKey third = first;
+    third[0] = Cell::Wall;
+    const ChunkTransition transition {};
+
+    cache.insert(first, transition);
+    cache.insert(second, transition);
+    REQUIRE(cache.find(first) != nullptr);
+    cache.insert(third, transition);
+
+    REQUIRE(cache.getSize() == 2);
+    REQUIRE(cache.find(first) != nullptr);
+    REQUIRE(cache.find(second) == nullptr);
+    REQUIRE(cache.find(third) != nullptr);
+    REQUIRE(cache.getHits() == 3);
+    REQUIRE(cache.getMisses() == 1);
+}
+
+TEST_CASE("every engine matches the reference engine")
+{
+    const Point size = GENERATE(Point(1, 5), Point(16, 16), Point(40, 33), Point(70, 48));
+    for (const EngineDescription& description : getEngines()) {
+        INFO(description.name);
+        const std::unique_ptr<SimulationEngine> engine = description.create();
+        const std::optional<Divergence> divergence = verifyOnRandomWorlds(*engine, size, 10, 30, 1);
+        if (divergence) {
+            FAIL(*divergence);
+        }
+    }
+}
+
+TEST_CASE("active particles match simulateStep while painting")
+{
+    const unsigned seed = GENERATE(1u, 2u, 3u);
+    const Point size(40, 30);
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<ptrdiff_t> x(0, size.x - 1);
+    std::uniform_int_distribution<ptrdiff_t> y(0, size.y - 1);
+    std::uniform_int_distribution<int> material(0, 4);
+
+    World world = createRandomWorld(size, seed);
+    World simulated = world;
+    ActiveParticleSimulation simulation(simulated);
+    SimulationSettings settings;
+    settings.brushSize = 3;
+    settings.brushStrength = 0.5f;
+    for (int step = 0; step < 100; ++step) {
+        if ((step % 5) == 0) {
+            settings.currentMaterial = static_cast<Cell>(material(random));
+            const Point center(x(random), y(random));
+            setRectangle(world, center, size, settings);
+            simulation.setRectangle(simulated, center, settings);
+        }
+        const std::pair<CellsChanged, World> expected = simulateStep(world);
+        REQUIRE(simulation.step(simulated, nullptr) == expected.first);
+        REQUIRE(simulated == expected.second);
+        world = expected.second;
+    }
+}
+
+TEST_CASE("active particles only visit moving cells")
+{
+    World world(Point(50, 50), Cell::Air);
+    for (ptrdiff_t x = 0; x < 50; ++x) {
+        world.Cells[(49 * 50) + x] = Cell::Wall;
+        world.Cells[(48 * 50) + x] = Cell::Snow;
+    }
+    world.Cells[10] = Cell::Sand;
+    ActiveParticleSimulation simulation(world);
+
+    REQUIRE(simulation.step(world, nullptr) == 1);
+    REQUIRE(simulation.getActiveCells() == 1);
+    while (simulation.step(world, nullptr) != 0) {
+    }
+    REQUIRE(simulation.getActiveCells() == 0);
+
+    // removing a cell wakes up the ones above it
+    World changed = world;
+    changed.Cells[(48 * 50) + 20] = Cell::Air;
+    changed.Cells[(47 * 50) + 20] = Cell::Snow;
+    simulation.update(world, changed);
+    REQUIRE(world == changed);
+    REQUIRE(simulation.getActiveCells() == 1);
+    REQUIRE(simulation.step(world, nullptr) == 1);
+    REQUIRE(world == simulateStep(changed).second);
+}
+
+TEST_CASE("every engine matches the reference engine when stepping in place")
+{
+    const Point size(40, 30);
+    std::mt19937 random(1);
+    std::uniform_int_distribution<ptrdiff_t> x(0, size.x - 1);
+    std::uniform_int_distribution<ptrdiff_t> y(0, size.y - 1);
+    std::uniform_int_distribution<int> material(0, 4);
+    SimulationSettings settings;
+    settings.brushSize = 4;
+    const bool isVerified = GENERATE(false, true);
+
+    for (const EngineDescription& description : getEngines()) {
+        INFO(description.name << (isVerified ? " (verified)" : ""));
+        std::unique_ptr<SimulationEngine> engine = description.create();
+        if (isVerified) {
+            engine = std::make_unique<VerifyingEngine>(std::move(engine));
+        }
+        World world = createRandomWorld(size, 1);
+        World expected = world;
+        for (int step = 0; step < 200; ++step) {
+            if ((step % 7) == 0) {
+                settings.currentMaterial = static_cast<Cell>(material(random));
+                const Point center(x(random), y(random));
+                setRectangle(world, center, size, settings);
+                setRectangle(expected, center, size, settings);
+                engine->regionChanged(world, getRectangleRegion(center, size, settings));
+            }
+            if ((step % 50) == 49) {
+                world = createRandomWorld(size, step);
+                expected = world;
+                engine->worldReplaced(world);
+            }
+            std::pair<CellsChanged, World> result = simulateStep(expected);
+            REQUIRE(engine->stepInPlace(world, nullptr) == result.first);
+            REQUIRE(world == result.second);
+            expected = std::move(result.second);
+        }
+        if (isVerified) {
+            REQUIRE(!static_cast<const VerifyingEngine&>(*engine).getFirstDivergence());
+        }
+    }
+}
+
+TEST_CASE("creating an unknown engine")
+{
+    REQUIRE(createEngine("Reference") != nullptr);
+    REQUIRE_THROWS_AS(createEngine("does not exist"), std::invalid_argument);
+}
+
+namespace {
+class SnowMeltingEngine : public SimulationEngine {
+public:
+    std::pair<CellsChanged, World> step(const World& world, ActivityMap* activity) override
+    {
+        std::pair<CellsChanged, World> result = simulateStep(world, activity);
+        std::replace(result.second.Cells.begin(), result.second.Cells.end(), Cell::Snow, Cell::Air);
+        return result;
+    }
+};
+}
+
+TEST_CASE("verification reports the first differing cell")
+{
+    const World world(2, { Cell::Air, Cell::Air,
+                             // below:
+                             Cell::Wall, Cell::Snow });
+    VerifyingEngine engine(std::make_unique<SnowMeltingEngine>());
+
+    const std::pair<CellsChanged, World> result = engine.step(world, nullptr);
+    REQUIRE(world == result.second);
+
+    const std::optional<Divergence>& divergence = engine.getFirstDivergence();
+    REQUIRE(divergence);
+    REQUIRE(divergence->position);
+    REQUIRE(divergence->position->x == 1);
+    REQUIRE(divergence->position->y == 1);
+    REQUIRE(divergence->expected == Cell::Snow);
+    REQUIRE(divergence->actual == Cell::Air);
+}
+
+TEST_CASE("verification in place keeps the reference result")
+{
+    World world(2, { Cell::Air, Cell::Snow,
+                       // below:
+                       Cell::Wall, Cell::Air });
+    VerifyingEngine engine(std::make_unique<SnowMeltingEngine>());
+
+    REQUIRE(engine.stepInPlace(world, nullptr) == 1);
+    REQUIRE(world == World(2, { Cell::Air, Cell::Air, Cell::Wall, Cell::Snow }));
+
+    const std::optional<Divergence>& divergence = engine.getFirstDivergence();
+    REQUIRE(divergence);
+    REQUIRE(divergence->position);
+    REQUIRE(divergence->position->x == 1);
+    REQUIRE(divergence->position->y == 1);
+}
+
+TEST_CASE("verification reports a different number of changed cells")
+{
+    const std::pair<CellsChanged, World> expected { 1, World(1, { Cell::Air, Cell::Snow }) };
+    const std::pair<CellsChanged, World> actual { 2, World(1, { Cell::Air, Cell::Snow }) };
+    const std::optional<Divergence> divergence = findDivergence(expected, actual);
+    REQUIRE(divergence);
+    REQUIRE(!divergence->position);
+    REQUIRE(divergence->expectedCellsChanged == 1);
+    REQUIRE(divergence->actualCellsChanged == 2);
+}
+
+TEST_CASE("the selected kernels are supported")
+{
+    REQUIRE(getSelectedKernelVariant().isSupported);
+    REQUIRE(getKernelVariants().back().isSupported);
+}
+
+TEST_CASE("all supported kernels produce the same results")
+{
+    const KernelVariant& baseline = getKernelVariants().back();
+    for (const KernelVariant& variant : getKernelVariants()) {
+        if (!variant.isSupported) {
+            continue;
+        }
+        INFO(variant.name);
+        for (unsigned seed = 0; seed < 10; ++seed) {
+            const World world = createRandomWorld(Point(67, 41), seed);
+            const ptrdiff_t worldWidth = world.Width;
+            const Region everything { 0, 0, worldWidth, static_cast<ptrdiff_t>(world.Cells.size()) / worldWidth };
+
+            World expected(Point(67, 41), Cell::Air);
+            World actual(Point(67, 41), Cell::Air);
+            const CellsChanged expectedCellsChanged = baseline.kernels.simulateRegion(world.Cells.data(), expected.Cells.data(), worldWidth, world.Cells.size(), everything, nullptr, 0);
+            const CellsChanged actualCellsChanged = variant.kernels.simulateRegion(world.Cells.data(), actual.Cells.data(), worldWidth, world.Cells.size(), everything, nullptr, 0);
+            REQUIRE(expectedCellsChanged == actualCellsChanged);
+            REQUIRE(expected == actual);
+
+            std::vector<std::uint8_t> expectedPixels(world.Cells.size() * 4);
+            std::vector<std::uint8_t> actualPixels(world.Cells.size() * 4);
+            baseline.kernels.renderCells(world.Cells.data(), world.Cells.size(), expectedPixels.data());
+            variant.kernels.renderCells(world.Cells.data(), world.Cells.size(), actualPixels.data());
+            REQUIRE(expectedPixels == actualPixels);
+        }
+    }
+}
+
+TEST_CASE("rendering cells")
+{
+    const std::vector<Cell> cells = { Cell::Air, Cell::Sand };
+    std::vector<std::uint8_t> pixels(cells.size() * 4);
+    getSelectedKernelVariant().kernels.renderCells(cells.data(), cells.size(), pixels.data());
+    REQUIRE(pixels == std::vector<std::uint8_t> { 0, 0, 0, 255, 180, 110, 0, 255 });
+}
+
+TEST_CASE("activity is counted per tile")
+{
+    World world(Point(20, 18), Cell::Air);
+    // falls in the top left tile
+    world.Cells[0] = Cell::Snow;
+    // falls in the bottom right tile
+    world.Cells[(16 * 20) + 17] = Cell::Sand;
+    // can't fall
+    world.Cells[(17 * 20) + 3] = Cell::Snow;
+
+    ActivityMap activity(Point(20, 18));
+    REQUIRE(activity.tiles.x == 2);
+    REQUIRE(activity.tiles.y == 2);
+
+    const std::pair<CellsChanged, World> result = simulateStep(world, &activity);
+    REQUIRE(2 == result.first);
+    REQUIRE(activity.changes == std::vector<std::uint32_t> { 1, 0, 0, 1 });
+    REQUIRE(simulateStep(world) == result);
+
+    std::ostringstream out;
+    out << activity;
+    REQUIRE(out.str() == "1,0\n0,1\n");
+}
+
+TEST_CASE("every engine counts the same activity as the reference engine")
+{
+    const Point size = GENERATE(Point(16, 16), Point(40, 37), Point(80, 70));
+    for (const EngineDescription& description : getEngines()) {
+        INFO(description.name);
+        const std::unique_ptr<SimulationEngine> engine = description.create();
+        for (unsigned seed = 0; seed < 5; ++seed) {
+            World world = createRandomWorld(size, seed);
+            ActivityMap expected(size);
+            ActivityMap actual(size);
+            for (int step = 0; step < 20; ++step) {
+                std::pair<CellsChanged, World> result = simulateStep(world, &expected);
+                engine->step(world, &actual);
+                world = std::move(result.second);
+            }
+            REQUIRE(expected.changes == actual.changes);
+        }
+    }
+}
+
+namespace {
+using namespace std::chrono_literals;
+
+// simulates frames that start every 16 ms (or later if the last one took longer), in which every step takes stepCost
+StepScheduler::Duration runFrames(StepScheduler& scheduler, const SimulationSettings& settings, const StepScheduler::Duration stepCost, const size_t frames, StepScheduler::Duration now)
+{
+    for (size_t frame = 0; frame < frames; ++frame) {
+        now = std::max<StepScheduler::Duration>(now, 16ms * static_cast<int>(frame));
+        const size_t steps = scheduler.beginFrame(now, settings);
+        for (size_t i = 0; i < steps; ++i) {
+            scheduler.recordStep(stepCost);
+            now += stepCost;
+        }
+        scheduler.endFrame(now, settings, false);
+    }
+    return now;
+}
+
+// Like the time-sliced stepping in main, returns the number of completed steps.
+size_t runSlicedFrames(StepScheduler& scheduler, const SimulationSettings& settings, const StepScheduler::Duration stepCost, const StepScheduler::Duration sliceCost, const size_t frames)
+{
+    StepScheduler::Duration now = 0ms;
+    StepScheduler::Duration remainingCost = 0ms;
+    size_t completedSteps = 0;
+    for (size_t frame = 0; frame < frames; ++frame) {
+        now = std::max<StepScheduler::Duration>(now, 16ms * static_cast<int>(frame));
+        const StepScheduler::Duration stopStepping = now + std::chrono::milliseconds(settings.frameBudgetInMilliseconds);
+        size_t plannedSteps = scheduler.beginFrame(now, settings);
+        do {
+            if (remainingCost == 0ms) {
+                if (plannedSteps == 0) {
+                    break;
+                }
+                --plannedSteps;
+                remainingCost = stepCost;
+            }
+            const StepScheduler::Duration slice = std::min(sliceCost, remainingCost);
+            now += slice;
+            remainingCost -= slice;
+            if (remainingCost == 0ms) {
+                scheduler.recordStep(stepCost);
+                ++completedSteps;
+            }
+        } while (now < stopStepping);
+        scheduler.endFrame(now, settings, remainingCost > 0ms);
+    }
+    return completedSteps;
+}
+}
+
+TEST_CASE("scheduler runs the steps that are due")
+{
+    SimulationSettings settings;
+    settings.timeBetweenStepsInMilliseconds = 3;
+    StepScheduler scheduler(0ms);
+
+    // nothing is known about the cost of a step yet
+    REQUIRE(scheduler.beginFrame(0ms, settings) == 1);
+    scheduler.recordStep(1ms);
+    scheduler.endFrame(1ms, settings, false);
+    REQUIRE(scheduler.getPredictedStepCost() == 1ms);
+
+    // ticks at 3, 6, 9 and 12 ms
+    REQUIRE(scheduler.beginFrame(12ms, settings) == 4);
+    REQUIRE(scheduler.beginFrame(2ms, settings) == 0);
+}
+
+TEST_CASE("scheduler doesn't plan more steps than fit into the frame budget")
+{
+    SimulationSettings settings;
+    settings.timeBetweenStepsInMilliseconds = 1;
+    settings.frameBudgetInMilliseconds = 15;
+    StepScheduler scheduler(0ms);
+    scheduler.beginFrame(0ms, settings);
+    scheduler.recordStep(4ms);
+    scheduler.endFrame(4ms, settings, false);
+
+    REQUIRE(scheduler.beginFrame(1000ms, settings) == 3);
+}
+
+TEST_CASE("scheduler keeps the backlog bounded")
+{
+    SimulationSettings settings;
+    settings.timeBetweenStepsInMilliseconds = 1;
+    settings.backlogPolicy = GENERATE(BacklogPolicy::CatchUp, BacklogPolicy::DropTicks, BacklogPolicy::LowerTickRate);
+    StepScheduler scheduler(0ms);
+
+    // every step takes longer than a frame
+    runFrames(scheduler, settings, 20ms, 500, 0ms);
+
+    const SchedulerStatistics statistics = scheduler.getStatistics();
+    REQUIRE(statistics.stepsLastFrame <= 1);
+    REQUIRE(statistics.backlog <= 250);
+    REQUIRE(statistics.droppedTicks > 0);
+    if (settings.backlogPolicy == BacklogPolicy::LowerTickRate) {
+        REQUIRE(statistics.tickInterval > 1ms);
+    } else {
+        REQUIRE(statistics.tickInterval == 1ms);
+    }
+}
+
+TEST_CASE("scheduler doesn't drop ticks that it has the time for")
+{
+    SimulationSettings settings;
+    settings.timeBetweenStepsInMilliseconds = 3;
+    settings.frameBudgetInMilliseconds = 15;
+    settings.backlogPolicy = GENERATE(BacklogPolicy::CatchUp, BacklogPolicy::DropTicks, BacklogPolicy::LowerTickRate);
+    StepScheduler scheduler(0ms);
+
+    // 60 frames per second for 10 seconds, every frame has 5 or 6 steps of 1 ms
+    runFrames(scheduler, settings, 1ms, 600, 0ms);
+
+    const SchedulerStatistics statistics = scheduler.getStatistics();
+    REQUIRE(statistics.droppedTicks == 0);
+    REQUIRE(statistics.backlog == 0);
+    REQUIRE(statistics.tickInterval == 3ms);
+}
+
+TEST_CASE("scheduler restores the tick rate once the steps are fast again")
+{
+    SimulationSettings settings;
+    settings.timeBetweenStepsInMilliseconds = 10;
+    settings.backlogPolicy = BacklogPolicy::LowerTickRate;
+    StepScheduler scheduler(0ms);
+
+    const StepScheduler::Duration now = runFrames(scheduler, settings, 30ms, 50, 0ms);
+    REQUIRE(scheduler.getStatistics().tickInterval > 10ms);
+
+    runFrames(scheduler, settings, 10us, 500, now);
+    REQUIRE(scheduler.getStatistics().tickInterval == 10ms);
+}
+
+TEST_CASE("scheduler keeps up with steps that are spread over several frames")
+{
+    SimulationSettings settings;
+    settings.timeBetweenStepsInMilliseconds = 3;
+    settings.frameBudgetInMilliseconds = 15;
+    settings.isTimeSliced = true;
+    settings.backlogPolicy = GENERATE(BacklogPolicy::CatchUp, BacklogPolicy::DropTicks, BacklogPolicy::LowerTickRate);
+    StepScheduler scheduler(0ms);
+
+    // 60 frames per second for 10 seconds, every step takes 60 ms in slices of 1 ms, so 4 frames per step
+    REQUIRE(runSlicedFrames(scheduler, settings, 60ms, 1ms, 600) == 150);
+    REQUIRE(scheduler.getStatistics().tickInterval == 3ms);
+}
+
+TEST_CASE("scheduler ignores the tick rate for max throughput")
+{
+    SimulationSettings settings;
+    settings.timeBetweenStepsInMilliseconds = 1000;
+    settings.frameBudgetInMilliseconds = 10;
+    settings.isMaxThroughput = true;
+    StepScheduler scheduler(0ms);
+    scheduler.beginFrame(0ms, settings);
+    scheduler.recordStep(1ms);
+    scheduler.endFrame(1ms, settings, false);
+
+    REQUIRE(scheduler.beginFrame(2ms, settings) == 10);
+}
+
+TEST_CASE("ensemble results are the same as stepping every world on its own")
+{
+    const size_t numberOfThreads = GENERATE(1, 4);
+    std::vector<World> worlds;
+    for (unsigned seed = 0; seed < 20; ++seed) {
+        worlds.push_back(createRandomWorld(Point(10 + seed, 30 - seed), seed));
+    }
+    worlds.push_back(World(Point(0, 0), Cell::Air));
+
+    EnsembleSettings settings;
+    settings.maximumSteps = 15;
+    settings.numberOfThreads = numberOfThreads;
+    settings.isActivityRecorded = true;
+    const std::vector<EnsembleResult> results = runEnsemble(worlds, settings);
+    REQUIRE(results.size() == worlds.size());
+
+    for (size_t i = 0; i < worlds.size(); ++i) {
+        INFO(i);
+        World expected = worlds[i];
+        size_t steps = 0;
+        bool isSettled = false;
+        CellsChanged totalCellsChanged = 0;
+        std::optional<ActivityMap> activity;
+        if (expected.Width != 0) {
+            activity.emplace(Point(expected.Width, expected.Cells.size() / expected.Width));
+        }
+        while ((expected.Width != 0) && (steps < settings.maximumSteps)) {
+            const std::pair<CellsChanged, World> result = simulateStep(expected, &*activity);
+            expected = result.second;
+            ++steps;
+            totalCellsChanged += result.first;
+            if (result.first == 0) {
+                isSettled = true;
+                break;
+            }
+        }
+
+        const EnsembleResult& result = results[i];
+        REQUIRE(result.world == expected);
+        REQUIRE(result.steps == steps);
+        REQUIRE(result.isSettled == (isSettled || (expected.Width == 0)));
+        REQUIRE(result.totalCellsChanged == totalCellsChanged);
+        REQUIRE(result.activity.has_value() == activity.has_value());
+        if (activity) {
+            REQUIRE(result.activity->changes == activity->changes);
+        }
+    }
+}
+
+TEST_CASE("ensemble stops at the step limit")
+{
+    const World world(1, { Cell::Snow, Cell::Air, Cell::Air, Cell::Air });
+    EnsembleSettings settings;
+    settings.maximumSteps = 2;
+    const std::vector<EnsembleResult> results = runEnsemble({ world }, settings);
+    REQUIRE(results[0].steps == 2);
+    REQUIRE(!results[0].isSettled);
+    REQUIRE(results[0].world == World(1, { Cell::Air, Cell::Air, Cell::Snow, Cell::Air }));
+}
+
+TEST_CASE("resumable step is the same as simulateStep")
+{
+    const ptrdiff_t rowsPerCall = GENERATE(1, 5, 16, 1000);
+    const Point size = GENERATE(Point(1, 1), Point(16, 16), Point(37, 50));
+    World world = createRandomWorld(size, 1);
+    for (int step = 0; step < 10; ++step) {
+        ActivityMap expectedActivity(size);
+        const std::pair<CellsChanged, World> expected = simulateStep(world, &expectedActivity);
+
+        ResumableStep resumable(world);
+        size_t calls = 1;
+        while (!resumable.advance(rowsPerCall)) {
+            REQUIRE(resumable.getProgress() < 1.0f);
+            ++calls;
+        }
+        REQUIRE(calls == static_cast<size_t>((size.y + rowsPerCall - 1) / rowsPerCall));
+        REQUIRE(resumable.getProgress() == 1.0f);
+        // the activity of a step that is dropped before it is finished is never added
+        ActivityMap activity(size);
+        REQUIRE(resumable.finish(&activity) == expected);
+        REQUIRE(activity.changes == expectedActivity.changes);
+        world = expected.second;
+    }
+}
+
+TEST_CASE("resumable step paints the brush strokes from during the step over its result")
+{
+    World world(2, {
+                       Cell::Air,
+                       Cell::Air,
+                       // below:
+                       Cell::Air,
+                       Cell::Snow,
+                       // below:
+                       Cell::Air,
+                       Cell::Air,
+                   });
+    ResumableStep resumable(world);
+    REQUIRE_THROWS_AS(resumable.finish(nullptr), std::logic_error);
+    REQUIRE(!resumable.advance(1));
+
+    // only paints every other cell of the brush, starting with the second one, so the Snow isn't painted over
+    SimulationSettings settings;
+    settings.brushSize = 1;
+    settings.brushStrength = 0.5f;
+    settings.currentMaterial = Cell::Wall;
+    setRectangle(world, Point(1, 1), Point(2, 3), settings);
+    resumable.setRectangle(Point(1, 1), settings);
+    REQUIRE(world == World(2, { Cell::Air, Cell::Air, Cell::Wall, Cell::Snow, Cell::Air, Cell::Air }));
+
+    REQUIRE(!resumable.advance(1));
+    REQUIRE(resumable.advance(1));
+    REQUIRE(resumable.finish(nullptr)
+        == std::pair<CellsChanged, World>(1,
+            World(2, {
+                         Cell::Air,
+                         Cell::Air,
+                         // below:
+                         Cell::Wall,
+                         Cell::Air,
+                         // below:
+                         Cell::Air,
+                         Cell::Snow,
+                     })));
+}
@@ -0,0 +1,213 @@
+#include "transition_cache.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+size_t ChunkKeyHash::operator()(const ChunkKey& key) const noexcept
+{
+    static_assert((sizeof(ChunkKey) % sizeof(std::uint64_t)) == 0);
+    std::uint64_t hash = 0;
+    for (size_t offset = 0; offset < sizeof(ChunkKey); offset += sizeof(std::uint64_t)) {
+        std::uint64_t word;
+        std::memcpy(&word, key.data() + offset, sizeof(word));
+        hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+        hash ^= (hash >> 29);
+    }
+    return static_cast<size_t>(hash);
+}
+
+TransitionCache::TransitionCache(size_t capacity)
+    : capacity(capacity)
+{
+}
+
+const ChunkTransition* TransitionCache::find(const ChunkKey& key)
+{
+    const auto found = index.find(key);
+    if (found == index.end()) {
+        ++misses;
+        return nullptr;
+    }
+    ++hits;
+    entries.splice(entries.begin(), entries, found->second);
+    return &found->second->second;
+}
+
+void TransitionCache::insert(const ChunkKey& key, const ChunkTransition& transition)
+{
+    if (capacity == 0) {
+        return;
+    }
+    const auto found = index.find(key);
+    if (found != index.end()) {
+        found->second->second = transition;
+        entries.splice(entries.begin(), entries, found->second);
+        return;
+    }
+    if (entries.size() >= capacity) {
+        index.erase(entries.back().first);
+        entries.pop_back();
+    }
+    entries.emplace_front(key, transition);
+    index.emplace(key, entries.begin());
+}
+
+void TransitionCache::clear()
+{
+    entries.clear();
+    index.clear();
+    hits = 0;
+    misses = 0;
+}
+
+size_t TransitionCache::getHits() const
+{
+    return hits;
+}
+
+size_t TransitionCache::getMisses() const
+{
+    return misses;
+}
+
+size_t TransitionCache::getSize() const
+{
+    return entries.size();
+}
+
+size_t TransitionCache::getCapacity() const
+{
+    return capacity;
+}
+
+namespace {
+void copyRows(const Cell* from, const ptrdiff_t fromStride, Cell* into, const ptrdiff_t intoStride, const ptrdiff_t rows)
+{
+    for (ptrdiff_t row = 0; row < rows; ++row) {
+        std::memcpy(into + (row * intoStride), from + (row * fromStride), ChunkSize * sizeof(Cell));
+    }
+}
+
+bool columnContainsSand(const World& world, const ptrdiff_t x, const ptrdiff_t top, const ptrdiff_t bottom)
+{
+    const ptrdiff_t worldWidth = world.Width;
+    const Cell* const cells = world.Cells.data();
+    for (ptrdiff_t y = top; y < bottom; ++y) {
+        if (cells[(y * worldWidth) + x] == Cell::Sand) {
+            return true;
+        }
+    }
+    return false;
+}
+
+CellsChanged simulateChunk(const World& world, World& into, const Region& chunk, TransitionCache& cache, ActivityMap* activity)
+{
+    const ptrdiff_t worldWidth = world.Width;
+    const ptrdiff_t worldHeight = world.Cells.size() / world.Width;
+    const bool isAtTheBottom = (chunk.bottom == worldHeight);
+    Cell* const firstCell = into.Cells.data() + (chunk.top * worldWidth) + chunk.left;
+    Cell* const firstCellBelow = isAtTheBottom ? nullptr : (firstCell + (ChunkSize * worldWidth));
+
+    ChunkKey key;
+    Cell* const keyBelow = key.data() + (ChunkSize * ChunkSize);
+    copyRows(world.Cells.data() + (chunk.top * worldWidth) + chunk.left, worldWidth, key.data(), ChunkSize, ChunkSize);
+    if (isAtTheBottom) {
+        // nothing can fall out of the world, which is exactly how a row of Walls behaves
+        std::fill(keyBelow, keyBelow + ChunkSize, Cell::Wall);
+    } else {
+        copyRows(firstCellBelow, worldWidth, keyBelow, ChunkSize, 1);
+    }
+
+    static_assert(ChunkSize <= ActivityTileSize, "a chunk has to fit into two rows of tiles");
+    const std::int32_t tileSplit = static_cast<std::int32_t>(ActivityTileSize - (chunk.top % ActivityTileSize));
+    const ChunkTransition* const known = cache.find(key);
+    // the split only differs if the height of the world has changed since the transition was cached
+    if ((known != nullptr) && (known->tileSplit == tileSplit)) {
+        copyRows(known->Cells.data(), ChunkSize, firstCell, worldWidth, isAtTheBottom ? ChunkSize : (ChunkSize + 1));
+        if (activity != nullptr) {
+            const ptrdiff_t tileColumn = chunk.left / ActivityTileSize;
+            const ptrdiff_t tileRow = chunk.top / ActivityTileSize;
+            activity->changes[(tileRow * activity->tiles.x) + tileColumn] += static_cast<std::uint32_t>(known->tileRowCellsChanged[0]);
+            if (tileSplit < ChunkSize) {
+                activity->changes[((tileRow + 1) * activity->tiles.x) + tileColumn] += static_cast<std::uint32_t>(known->tileRowCellsChanged[1]);
+            }
+        }
+        return known->cellsChanged;
+    }
+
+    // one call per row of tiles, from the bottom up
+    ChunkTransition transition;
+    transition.tileSplit = tileSplit;
+    transition.tileRowCellsChanged[1] = 0;
+    if (tileSplit < ChunkSize) {
+        transition.tileRowCellsChanged[1] = simulateRegion(world, into, Region { chunk.left, chunk.top + tileSplit, chunk.right, chunk.bottom }, activity);
+    }
+    transition.tileRowCellsChanged[0] = simulateRegion(world, into, Region { chunk.left, chunk.top, chunk.right, chunk.top + std::min<ptrdiff_t>(tileSplit, ChunkSize) }, activity);
+    transition.cellsChanged = transition.tileRowCellsChanged[0] + transition.tileRowCellsChanged[1];
+    copyRows(firstCell, worldWidth, transition.Cells.data(), ChunkSize, ChunkSize);
+    Cell* const transitionBelow = transition.Cells.data() + (ChunkSize * ChunkSize);
+    if (isAtTheBottom) {
+        std::fill(transitionBelow, transitionBelow + ChunkSize, Cell::Wall);
+    } else {
+        copyRows(firstCellBelow, worldWidth, transitionBelow, ChunkSize, 1);
+    }
+    cache.insert(key, transition);
+    return transition.cellsChanged;
+}
+}
+
+std::pair<CellsChanged, World> simulateStepCached(const World& world, TransitionCache& cache, ActivityMap* activity)
+{
+    const ptrdiff_t worldWidth = world.Width;
+    if (worldWidth == 0) {
+        return { 0, world };
+    }
+    const ptrdiff_t worldHeight = world.Cells.size() / world.Width;
+    World result(Point { worldWidth, worldHeight }, Cell::Air);
+    CellsChanged cellsChanged = 0;
+
+    static_assert((ChunkSize % ActivityTileSize) == 0, "every chunk has to be in a single column of tiles");
+    const ptrdiff_t numberOfChunks = (worldWidth + ChunkSize - 1) / ChunkSize;
+    std::vector<bool> leftEdgeHasSand(numberOfChunks);
+    std::vector<bool> rightEdgeHasSand(numberOfChunks);
+
+    // Bands of chunks are simulated from the bottom up just like the rows in simulateStep. Only Sand can move
+    // sideways, so a chunk is independent of its horizontal neighbours if there is no Sand next to the border.
+    for (ptrdiff_t bottom = worldHeight; bottom > 0; bottom -= ChunkSize) {
+        const ptrdiff_t top = std::max<ptrdiff_t>(0, bottom - ChunkSize);
+        if ((bottom - top) < ChunkSize) {
+            cellsChanged += simulateRegion(world, result, Region { 0, top, worldWidth, bottom }, activity);
+            continue;
+        }
+
+        for (ptrdiff_t i = 0; i < numberOfChunks; ++i) {
+            const ptrdiff_t left = (i * ChunkSize);
+            const ptrdiff_t right = std::min(left + ChunkSize, worldWidth);
+            leftEdgeHasSand[i] = columnContainsSand(world, left, top, bottom);
+            rightEdgeHasSand[i] = columnContainsSand(world, right - 1, top, bottom);
+        }
+
+        // consecutive chunks that can't be looked up are simulated together
+        ptrdiff_t uncachedRight = worldWidth;
+        for (ptrdiff_t i = (numberOfChunks - 1); i >= 0; --i) {
+            const ptrdiff_t left = (i * ChunkSize);
+            const ptrdiff_t right = (left + ChunkSize);
+            const bool isIndependent = (right <= worldWidth)
+                && !leftEdgeHasSand[i] && !rightEdgeHasSand[i]
+                && ((i == 0) || !rightEdgeHasSand[i - 1])
+                && ((i == (numberOfChunks - 1)) || !leftEdgeHasSand[i + 1]);
+            if (!isIndependent) {
+                continue;
+            }
+            if (uncachedRight > right) {
+                cellsChanged += simulateRegion(world, result, Region { right, top, uncachedRight, bottom }, activity);
+            }
+            cellsChanged += simulateChunk(world, result, Region { left, top, right, bottom }, cache, activity);
+            uncachedRight = left;
+        }
+        if (uncachedRight > 0) {
+            cellsChanged += simulateRegion(world, result, Region { 0, top, uncachedRight, bottom }, activity);
+        }
+    }
+    return { cellsChanged, std::move(result) };
+}
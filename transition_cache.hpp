@@ -0,0 +1,57 @@
+#pragma once
+#include "simulation.hpp"
+#include <array>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+
+// Edge length of the square chunks whose transitions are memoised.
+constexpr ptrdiff_t ChunkSize = 16;
+
+// The cells of a chunk followed by the already simulated row below it.
+using ChunkKey = std::array<Cell, ChunkSize * (ChunkSize + 1)>;
+
+struct ChunkKeyHash {
+    size_t operator()(const ChunkKey& key) const noexcept;
+};
+
+// The next state of a chunk and of the row below it (cells can fall out of the chunk).
+struct ChunkTransition {
+    std::array<Cell, ChunkSize * (ChunkSize + 1)> Cells;
+    CellsChanged cellsChanged;
+    // The bands of chunks aren't aligned with the tiles of an ActivityMap, so a chunk can cover two rows of tiles.
+    // tileSplit is the number of rows of the chunk in the upper one.
+    std::int32_t tileSplit;
+    std::array<CellsChanged, 2> tileRowCellsChanged;
+};
+
+// Bounded least-recently-used map from chunk contents to their next state.
+class TransitionCache {
+public:
+    explicit TransitionCache(size_t capacity);
+
+    // Returns nullptr on a miss. The pointer is valid until the next call to insert or clear.
+    const ChunkTransition* find(const ChunkKey& key);
+    void insert(const ChunkKey& key, const ChunkTransition& transition);
+    void clear();
+
+    size_t getHits() const;
+    size_t getMisses() const;
+    size_t getSize() const;
+    size_t getCapacity() const;
+
+private:
+    using Entry = std::pair<ChunkKey, ChunkTransition>;
+
+    size_t capacity;
+    size_t hits = 0;
+    size_t misses = 0;
+    // most recently used first
+    std::list<Entry> entries;
+    std::unordered_map<ChunkKey, std::list<Entry>::iterator, ChunkKeyHash> index;
+};
+
+// Produces exactly the same result as simulateStep, but looks up chunks that were already seen in `cache`.
+// Chunks that can exchange Sand with their horizontal neighbours are simulated normally.
+// activity may be nullptr, otherwise the changed cells are added to it.
+std::pair<CellsChanged, World> simulateStepCached(const World& world, TransitionCache& cache, ActivityMap* activity);